@@ -1,10 +1,105 @@
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
 #include "gameComponents.h"
 
 using namespace std;
 
-int main()
+// Plays a recorded game repeat times without a terminal and prints how it ended and how fast it ran
+int run_replay(const char *path, uint64_t repeat)
 {
+    Replay replay;
+    if (!replay.load(path))
+    {
+        cerr << "Could not read the replay " << path << endl;
+        return 1;
+    }
+
+    unsigned events = 0;
+    unsigned outcome = 0;
+    int moves = 0, coins = 0, score = 0;
+    double seconds = 0;
+    for (uint64_t i = 0; i < repeat; i++)
+    {
+        // Every run starts from a new grid, only the steps are timed and building the level is not
+        Grid grid;
+        grid.set_random(replay.get_random());
+        grid.initialize_grid(replay.get_level(), replay.get_size());
+        auto start = chrono::steady_clock::now();
+        events = 0;
+        for (int j = 0; j < replay.get_count(); j++)
+            events |= grid.step(replay.at(j));
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        Player &player = grid.get_player();
+        outcome = grid.get_outcome();
+        moves = player.get_moves();
+        coins = player.get_coins();
+        score = player.get_score();
+    }
+
+    if (outcome == Event::won)
+        cout << "Won";
+    else if (outcome == Event::bomb)
+        cout << "Hit Bomb";
+    else if (outcome == Event::no_moves)
+        cout << "No More Moves";
+    else
+        cout << "Not finished";
+    cout << ", level " << replay.get_level() << ", seed " << replay.get_random().get_seed() << endl;
+    cout << "Commands: " << replay.get_count() << ", remaining moves: " << moves
+         << ", coins: " << coins << ", score: " << score << endl;
+    if (events & Event::backtrack)
+        cout << "Some commands tried to move back to the last position" << endl;
+
+    double steps = (double)replay.get_count() * repeat;
+    cout << "Time: " << seconds << " s for " << repeat << " runs, " << (seconds > 0 ? steps / seconds : 0) << " steps per second" << endl;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // Read the seed to rebuild a level with, a fresh one is chosen when none is given
+    uint64_t seed = Random::fresh_seed();
+    uint64_t repeat = 1;
+    const char *recordPath = nullptr;
+    const char *replayPath = nullptr;
+    bool valid = true;
+    for (int i = 1; i < argc && valid; i++)
+    {
+        if (i + 1 >= argc)
+            valid = false;
+        else if (strcmp(argv[i], "--seed") == 0)
+            valid = read_number(argv[++i], seed);
+        else if (strcmp(argv[i], "--record") == 0)
+            recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0)
+            replayPath = argv[++i];
+        else if (strcmp(argv[i], "--repeat") == 0)
+            valid = read_number(argv[++i], repeat) && repeat >= 1;
+        else
+            valid = false;
+    }
+    if (!valid || (replayPath != nullptr && recordPath != nullptr))
+    {
+        cerr << "Usage: " << argv[0] << " [--seed number] [--record file]" << endl;
+        cerr << "       " << argv[0] << " --replay file [--repeat number]" << endl;
+        return 1;
+    }
+
+    // A replay runs without the terminal
+    if (replayPath != nullptr)
+        return run_replay(replayPath, repeat);
+
+    // The recording is opened before the game starts and written as it is played
+    Replay recording;
+    if (recordPath != nullptr && !recording.record(recordPath))
+    {
+        cerr << "Could not write the replay " << recordPath << endl;
+        return 1;
+    }
+
     initscr(); // Start ncurses mode
     cbreak();  // Disable line buffering
     noecho();  // Don't echo input to the screen
@@ -14,23 +109,51 @@ int main()
     printw("1. Easy\n");
     printw("2. Medium\n");
     printw("3. Hard\n");
+    printw("4. Custom\n");
     printw("Enter number to select: ");
 
     int level = 0;
     do
     {
         level = (getch() - '0');
-        if (level < 1 || level > 3)
+        if (level < 1 || level > 4)
             printw("Invalid Input!\nInput again: ");
-    } while (level < 1 || level > 3); // Input again if the input is invalid
+    } while (level < 1 || level > 4); // Input again if the input is invalid
+
+    // Prompt the user for the board size of the custom level
+    int size = 0;
+    if (level == 4)
+    {
+        printw("\nEnter board size (5 to 5000): ");
+        do
+        {
+            size = 0;
+            int input = getch();
+            while (input >= '0' && input <= '9')
+            {
+                addch(input); // Echo the digit since echo is disabled
+                if (size < 10000)
+                    size = size * 10 + (input - '0');
+                input = getch();
+            }
+            if (size < 5 || size > 5000)
+                printw("\nInvalid Input!\nInput again: ");
+        } while (size < 5 || size > 5000); // Input again if the size is invalid
+    }
 
     clear();
 
-    Game game(level);
+    Game game(level, size, Random(seed), recordPath != nullptr ? &recording : nullptr);
     game.game_loop(); // Run the main game loop
 
     getch();
     endwin();
 
+    if (!recording.is_written())
+    {
+        cerr << "Could not write the replay " << recordPath << endl;
+        return 1;
+    }
+
     return 0;
 }
\ No newline at end of file
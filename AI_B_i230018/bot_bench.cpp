@@ -0,0 +1,409 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#define MAZE_HEADLESS // Games are played without a terminal, so ncurses is left out
+#include "gameComponents.h"
+
+using namespace std;
+
+// Bots that play the benchmark games
+enum class Bot
+{
+    random_walk, // Moves to a random open cell, undoes only when every way forward is closed
+    greedy       // Moves to the open cell closest to the key, then to the door, and never steps on a bomb
+};
+
+// Board the games are played on, the size is only used by the custom level
+struct Board
+{
+    int level;
+    int size;
+};
+
+// What the games played by one thread on one board did
+struct Tally
+{
+    int size = 0; // Width of the board, which the level decides for all but the custom one
+    long long games = 0;
+    long long steps = 0;
+    long long won = 0;
+    long long bombs = 0;
+    long long no_moves = 0;
+    long long stuck = 0;        // Games the bot gave up, with no way to go on or after going round in circles
+    vector<uint32_t> latencies; // Nanoseconds taken by every step
+};
+
+// Numbers of one bot on one board, as printed and as saved for a later comparison
+struct Result
+{
+    string bot;
+    int level;
+    int size;
+    long long games, won, bombs, no_moves, stuck;
+    double games_per_second;
+    double moves_per_second;
+    uint32_t p50, p99, p999, worst;
+};
+
+// Returns the name of a bot
+const char *bot_name(Bot bot)
+{
+    return bot == Bot::greedy ? "greedy" : "random";
+}
+
+// A game is given up after this many commands for every move it started with
+// Taking a coin gives back the undo that returns from it, so a bot can go back and forth between two cells for ever
+const int commands_per_move = 16;
+
+// Picks the next command of the bot, none when it cannot go on
+// to_key and to_door hold the shortest paths around the bombs from the key and from the door, the ones the grid built with the level
+Command choose(Bot bot, Grid &grid, const DistanceField &to_key, const DistanceField &to_door, Random &random)
+{
+    Player &player = grid.get_player();
+    Pos pos = player.get_pos();
+    Pos last = player.get_last_move_pos();
+    int size = grid.get_size();
+    const DistanceField &field = player.has_key() ? to_door : to_key;
+
+    // In the order of the commands up, down, left and right
+    const Pos next[4] = {Pos(pos.x - 1, pos.y), Pos(pos.x + 1, pos.y), Pos(pos.x, pos.y - 1), Pos(pos.x, pos.y + 1)};
+
+    Command options[4];
+    int count = 0;
+    Command best = Command::none;
+    int bestDistance = INT_MAX;
+    for (int i = 0; i < 4; i++)
+    {
+        Pos cell = next[i];
+        if (cell.x < 0 || cell.x >= size || cell.y < 0 || cell.y >= size || grid.has_item(cell, Grid::wall_flag))
+            continue;
+
+        // The last cell cannot be moved to, only gone back to with an undo
+        bool back = cell == last;
+        if (back && player.get_undos() == 0)
+            continue;
+        if (bot == Bot::greedy && grid.has_item(cell, Grid::bomb_flag))
+            continue;
+        if (!back)
+            options[count++] = (Command)i;
+        if (field.reaches(cell) && field.at(cell) < bestDistance)
+        {
+            bestDistance = field.at(cell);
+            best = back ? Command::undo : (Command)i;
+        }
+    }
+
+    if (bot == Bot::greedy && best != Command::none)
+        return best;
+    if (count > 0)
+        return options[random.below(count)];
+    return player.get_undos() > 0 ? Command::undo : Command::none;
+}
+
+// Plays the games from first up to last on one board, the work of one thread
+// Game number i is built from stream i of seed, so every game is the same for any number of threads
+void play_games(Bot bot, Board board, uint64_t seed, int first, int last, Tally &tally)
+{
+    tally.latencies.reserve(tally.latencies.size() + (size_t)(last - first) * 64);
+
+    for (int i = first; i < last; i++)
+    {
+        Grid grid;
+        grid.set_random(Random(seed, (uint64_t)i));
+        grid.initialize_grid(board.level, board.size);
+
+        tally.size = grid.get_size();
+
+        // The bot draws from a generator of its own, so its choices do not change the level
+        Random random(~seed, (uint64_t)i);
+        long long limit = (long long)commands_per_move * grid.get_player().get_moves();
+        for (long long commands = 0; !grid.is_over(); commands++)
+        {
+            Command command = choose(bot, grid, grid.get_key_field(), grid.get_door_field(), random);
+            if (command == Command::none || commands == limit)
+            {
+                tally.stuck++;
+                break;
+            }
+
+            auto start = chrono::steady_clock::now();
+            grid.step(command);
+            auto end = chrono::steady_clock::now();
+            tally.latencies.push_back((uint32_t)min<long long>(chrono::duration_cast<chrono::nanoseconds>(end - start).count(), UINT32_MAX));
+            tally.steps++;
+        }
+
+        unsigned outcome = grid.get_outcome();
+        if (outcome == Event::won)
+            tally.won++;
+        else if (outcome == Event::bomb)
+            tally.bombs++;
+        else if (outcome == Event::no_moves)
+            tally.no_moves++;
+        tally.games++;
+    }
+}
+
+// Returns the latency below which the given share of the steps finished, the latencies are reordered
+uint32_t percentile(vector<uint32_t> &latencies, double share)
+{
+    if (latencies.empty())
+        return 0;
+
+    size_t index = min(latencies.size() - 1, (size_t)(share * latencies.size()));
+    nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+    return latencies[index];
+}
+
+// Plays games on a board with threads and adds up what they did
+Result run_board(Bot bot, Board board, int games, int threads, uint64_t seed)
+{
+    vector<Tally> tallies(threads);
+
+    // Every thread plays a contiguous share of the games into its own tally, so the threads never wait on each other
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        int first = (int)((long long)games * t / threads);
+        int last = (int)((long long)games * (t + 1) / threads);
+        workers.emplace_back(play_games, bot, board, seed, first, last, ref(tallies[t]));
+    }
+    for (thread &worker : workers)
+        worker.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    Tally total;
+    for (Tally &tally : tallies)
+    {
+        total.size = max(total.size, tally.size);
+        total.games += tally.games;
+        total.steps += tally.steps;
+        total.won += tally.won;
+        total.bombs += tally.bombs;
+        total.no_moves += tally.no_moves;
+        total.stuck += tally.stuck;
+        total.latencies.insert(total.latencies.end(), tally.latencies.begin(), tally.latencies.end());
+    }
+
+    Result result;
+    result.bot = bot_name(bot);
+    result.level = board.level;
+    result.size = total.size;
+    result.games = total.games;
+    result.won = total.won;
+    result.bombs = total.bombs;
+    result.no_moves = total.no_moves;
+    result.stuck = total.stuck;
+    result.games_per_second = total.games / seconds;
+    result.moves_per_second = total.steps / seconds;
+    result.p50 = percentile(total.latencies, 0.5);
+    result.p99 = percentile(total.latencies, 0.99);
+    result.p999 = percentile(total.latencies, 0.999);
+    result.worst = total.latencies.empty() ? 0 : *max_element(total.latencies.begin(), total.latencies.end());
+    return result;
+}
+
+// Prints the heading of the results table
+void print_heading()
+{
+    cout << left << setw(8) << "Bot" << setw(7) << "Level" << setw(6) << "Size" << right
+         << setw(8) << "Games" << setw(8) << "Won" << setw(8) << "Bomb" << setw(8) << "Out" << setw(8) << "Stuck"
+         << setw(12) << "Games/s" << setw(13) << "Moves/s"
+         << setw(9) << "p50 ns" << setw(9) << "p99 ns" << setw(10) << "p99.9 ns" << setw(10) << "Max ns" << endl;
+}
+
+// Prints one row of the results table
+void print_result(const Result &result)
+{
+    cout << left << setw(8) << result.bot << setw(7) << result.level << setw(6) << result.size << right
+         << setw(8) << result.games << setw(8) << result.won << setw(8) << result.bombs << setw(8) << result.no_moves << setw(8) << result.stuck
+         << fixed << setprecision(0) << setw(12) << result.games_per_second << setw(13) << result.moves_per_second
+         << setw(9) << result.p50 << setw(9) << result.p99 << setw(10) << result.p999 << setw(10) << result.worst << endl;
+}
+
+// Writes the results to a file, one line for every bot and board
+bool save_results(const char *path, const vector<Result> &results)
+{
+    ofstream file(path);
+    for (const Result &result : results)
+        file << result.bot << ' ' << result.level << ' ' << result.size << ' '
+             << result.games << ' ' << result.won << ' ' << result.bombs << ' ' << result.no_moves << ' ' << result.stuck << ' '
+             << result.games_per_second << ' ' << result.moves_per_second << ' '
+             << result.p50 << ' ' << result.p99 << ' ' << result.p999 << ' ' << result.worst << '\n';
+    return (bool)file;
+}
+
+// Reads results written by save_results, returns false when the file cannot be read
+bool load_results(const char *path, vector<Result> &results)
+{
+    ifstream file(path);
+    if (!file)
+        return false;
+
+    string line;
+    while (getline(file, line))
+    {
+        istringstream fields(line);
+        Result result;
+        if (fields >> result.bot >> result.level >> result.size
+                   >> result.games >> result.won >> result.bombs >> result.no_moves >> result.stuck
+                   >> result.games_per_second >> result.moves_per_second
+                   >> result.p50 >> result.p99 >> result.p999 >> result.worst)
+            results.push_back(result);
+    }
+    return true;
+}
+
+// Compares the results with a baseline, returns false when any board got slower than the tolerances allow
+// tolerance is for games and moves per second, latency_tolerance for the 99th percentile latency which jitters more
+// Games are the same on every run, so different outcomes mean the rules changed and are reported but not failed
+bool compare_results(const vector<Result> &results, const vector<Result> &baseline, double tolerance, double latency_tolerance)
+{
+    bool passed = true;
+    for (const Result &result : results)
+    {
+        for (const Result &base : baseline)
+        {
+            if (base.bot != result.bot || base.level != result.level || base.size != result.size)
+                continue;
+
+            cout << left << setw(8) << result.bot << setw(7) << result.level << setw(6) << result.size << right << fixed << setprecision(1)
+                 << "games/s " << setw(7) << 100 * (result.games_per_second / base.games_per_second - 1) << "%  "
+                 << "moves/s " << setw(7) << 100 * (result.moves_per_second / base.moves_per_second - 1) << "%  "
+                 << "p99 " << setw(7) << 100 * ((double)result.p99 / max(base.p99, 1u) - 1) << "%";
+
+            bool slower = result.games_per_second < base.games_per_second * (1 - tolerance / 100) ||
+                          result.moves_per_second < base.moves_per_second * (1 - tolerance / 100) ||
+                          result.p99 > base.p99 * (1 + latency_tolerance / 100);
+            if (slower)
+            {
+                cout << "  SLOWER";
+                passed = false;
+            }
+            if (base.games == result.games && (base.won != result.won || base.bombs != result.bombs ||
+                                               base.no_moves != result.no_moves || base.stuck != result.stuck))
+                cout << "  outcomes changed";
+            cout << endl;
+        }
+    }
+    return passed;
+}
+
+// Prints how to run the tool
+void print_usage(const char *name)
+{
+    cerr << "Usage: " << name << " [--bot random|greedy] [--games number] [--size 5-5000]... [--seed number] [--threads number]" << endl;
+    cerr << "       " << string(strlen(name), ' ') << " [--save file] [--compare file] [--tolerance percent] [--latency-tolerance percent]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    vector<Bot> bots = {Bot::random_walk, Bot::greedy};
+    vector<Board> boards = {{1, 0}, {2, 0}, {3, 0}};
+    vector<int> sizes;
+    uint64_t games = 1000;
+    uint64_t seed = 1;
+    uint64_t threads = max(1u, thread::hardware_concurrency());
+    uint64_t tolerance = 10;
+    uint64_t latencyTolerance = 50;
+    const char *savePath = nullptr;
+    const char *comparePath = nullptr;
+    bool valid = true;
+
+    for (int i = 1; i < argc && valid; i++)
+    {
+        uint64_t size = 0;
+        if (i + 1 >= argc)
+            valid = false;
+        else if (strcmp(argv[i], "--bot") == 0)
+        {
+            i++;
+            if (strcmp(argv[i], "random") == 0)
+                bots = {Bot::random_walk};
+            else if (strcmp(argv[i], "greedy") == 0)
+                bots = {Bot::greedy};
+            else
+                valid = false;
+        }
+        else if (strcmp(argv[i], "--games") == 0)
+            valid = read_number(argv[++i], games) && games >= 1 && games < (1u << 31);
+        else if (strcmp(argv[i], "--size") == 0)
+        {
+            valid = read_number(argv[++i], size) && size >= 5 && size <= 5000;
+            sizes.push_back((int)size);
+        }
+        else if (strcmp(argv[i], "--seed") == 0)
+            valid = read_number(argv[++i], seed);
+        else if (strcmp(argv[i], "--threads") == 0)
+            valid = read_number(argv[++i], threads) && threads >= 1 && threads <= 1024;
+        else if (strcmp(argv[i], "--save") == 0)
+            savePath = argv[++i];
+        else if (strcmp(argv[i], "--compare") == 0)
+            comparePath = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0)
+            valid = read_number(argv[++i], tolerance) && tolerance <= 100;
+        else if (strcmp(argv[i], "--latency-tolerance") == 0)
+            valid = read_number(argv[++i], latencyTolerance);
+        else
+            valid = false;
+    }
+    if (!valid)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Custom boards come after the three levels, a small and a large one when none are given
+    if (sizes.empty())
+        sizes = {50, 100};
+    for (int size : sizes)
+        boards.push_back({4, size});
+
+    vector<Result> baseline;
+    if (comparePath != nullptr && !load_results(comparePath, baseline))
+    {
+        cerr << "Could not read " << comparePath << endl;
+        return 1;
+    }
+
+    cout << "Seed: " << seed << ", threads: " << threads << ", games per board: " << games << endl;
+    print_heading();
+    vector<Result> results;
+    for (Bot bot : bots)
+    {
+        for (Board board : boards)
+        {
+            results.push_back(run_board(bot, board, (int)games, (int)threads, seed));
+            print_result(results.back());
+        }
+    }
+
+    if (savePath != nullptr && !save_results(savePath, results))
+    {
+        cerr << "Could not write " << savePath << endl;
+        return 1;
+    }
+
+    if (comparePath != nullptr)
+    {
+        cout << endl << "Compared with " << comparePath << ", tolerance " << tolerance << "%, latency tolerance " << latencyTolerance << "%:" << endl;
+        if (!compare_results(results, baseline, (double)tolerance, (double)latencyTolerance))
+        {
+            cout << "Slower than the baseline" << endl;
+            return 1;
+        }
+        cout << "Within the baseline" << endl;
+    }
+
+    return 0;
+}
@@ -2,8 +2,25 @@
 #define GAME_COMPONENTS_H
 
 #include <iostream>
-#include <ncurses.h>
+#include <cstdio>
+#include <cstdlib>
 #include <ctime>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+#include <random>
+#include <fstream>
+#include <string>
+
+// Define MAZE_HEADLESS to build the rules without ncurses, leaving out the drawing code and the Game front end
+#ifndef MAZE_HEADLESS
+#include <ncurses.h>
+#endif
 
 using namespace std;
 
@@ -40,82 +57,265 @@ struct Pos
         return x != other.x || y != other.y;
     }
 
+#ifndef MAZE_HEADLESS
     // Print the position
     void print() const
     {
         printw("(%d, %d)", x, y);
     }
+#endif
+};
+
+// Counters kept by the containers when the game is built with MAZE_INSTRUMENT defined
+struct ContainerStats
+{
+    long long allocations;     // Nodes handed out by node pools
+    long long frees;           // Nodes returned to node pools
+    long long live_nodes;      // Nodes currently in use
+    long long live_bytes;      // Bytes currently held by containers in slabs and element blocks
+    long long peak_bytes;      // Highest value live_bytes has reached
+    long long traversal_steps; // Links followed and elements visited while walking or searching containers
+
+    ContainerStats()
+    {
+        allocations = 0;
+        frees = 0;
+        live_nodes = 0;
+        live_bytes = 0;
+        peak_bytes = 0;
+        traversal_steps = 0;
+    }
+
+    // Returns the counters of the calling thread
+    static ContainerStats &current()
+    {
+        static thread_local ContainerStats stats;
+        return stats;
+    }
+
+    // Records bytes taken or, when negative, given back by a container
+    void add_bytes(long long bytes)
+    {
+        live_bytes += bytes;
+        peak_bytes = max(peak_bytes, live_bytes);
+    }
+
+    // Returns the counts gathered since the given snapshot, the live and peak values are kept as they are now
+    ContainerStats since(const ContainerStats &start) const
+    {
+        ContainerStats difference = *this;
+        difference.allocations -= start.allocations;
+        difference.frees -= start.frees;
+        difference.traversal_steps -= start.traversal_steps;
+        return difference;
+    }
+
+#ifndef MAZE_HEADLESS
+    // Prints the counters on one line
+    void print(const char *label) const
+    {
+        printw("%s: %lld allocs, %lld frees, %lld live nodes, %lld peak bytes, %lld steps\n",
+               label, allocations, frees, live_nodes, peak_bytes, traversal_steps);
+    }
+#endif
 };
 
-// Implements the cell structure
-class Cell
+#ifdef MAZE_INSTRUMENT
+#define COUNT_NODE_ALLOC() (ContainerStats::current().allocations++, ContainerStats::current().live_nodes++)
+#define COUNT_NODE_FREE() (ContainerStats::current().frees++, ContainerStats::current().live_nodes--)
+#define COUNT_BYTES(bytes) ContainerStats::current().add_bytes(bytes)
+#define COUNT_STEPS(steps) (ContainerStats::current().traversal_steps += (steps))
+#else
+#define COUNT_NODE_ALLOC() ((void)0)
+#define COUNT_NODE_FREE() ((void)0)
+#define COUNT_BYTES(bytes) ((void)0)
+#define COUNT_STEPS(steps) ((void)0)
+#endif
+
+// Implements a pool of fixed size blocks for container nodes
+// Blocks are carved out of contiguous slabs, freed blocks are kept in a free list for reuse and all slabs are released together when the pool is destroyed
+class NodePool
 {
 private:
-    Pos pos;
-    char symbol;
-    bool is_hidden;
+    struct Block
+    {
+        Block *next;
+    };
+
+    struct Slab
+    {
+        Slab *next;
+    };
+
+    static const size_t alignment = alignof(max_align_t);
+    static const size_t header_size = (sizeof(Slab) + alignment - 1) / alignment * alignment;
+
+    size_t blockSize;
+    int blocksPerSlab;
+    Block *freeList;
+    Slab *slabs;
+    int live;
+    int available; // Number of blocks in the free list
+
+    // Returns the size of a slab including its header
+    size_t slab_bytes()
+    {
+        return header_size + blockSize * blocksPerSlab;
+    }
+
+    // Allocates a new slab and puts all of its blocks in the free list
+    void add_slab()
+    {
+        char *memory = static_cast<char *>(::operator new(slab_bytes()));
+        COUNT_BYTES(slab_bytes());
+        Slab *slab = reinterpret_cast<Slab *>(memory);
+        slab->next = slabs;
+        slabs = slab;
+
+        for (int i = blocksPerSlab - 1; i >= 0; i--)
+        {
+            Block *block = reinterpret_cast<Block *>(memory + header_size + blockSize * i);
+            block->next = freeList;
+            freeList = block;
+        }
+        available += blocksPerSlab;
+    }
 
 public:
-    Cell() {}
-    Cell(int x, int y, char symbol)
+    NodePool(size_t blockSize, int blocksPerSlab = 64)
     {
-        pos.set_pos(x, y);
-        this->symbol = symbol;
-        is_hidden = false;
+        // Every block must be able to hold a free list link and keep the nodes aligned
+        blockSize = max(blockSize, sizeof(Block));
+        this->blockSize = (blockSize + alignment - 1) / alignment * alignment;
+        this->blocksPerSlab = blocksPerSlab;
+        freeList = nullptr;
+        slabs = nullptr;
+        live = 0;
+        available = 0;
     }
 
-    // Returns the position of a cell in the grid
-    Pos get_pos()
+    NodePool(const NodePool &) = delete;
+    NodePool &operator=(const NodePool &) = delete;
+
+    ~NodePool()
     {
-        return pos;
+        release();
     }
 
-    // Returns the character in the cell
-    char get_symbol()
+    // Returns a block of at least the given number of bytes
+    void *allocate(size_t bytes)
     {
-        return symbol;
+        if (bytes > blockSize)
+            throw std::invalid_argument("Node is larger than the pool blocks");
+
+        if (freeList == nullptr)
+            add_slab();
+
+        Block *block = freeList;
+        freeList = block->next;
+        live++;
+        available--;
+        COUNT_NODE_ALLOC();
+        return block;
     }
 
-    // Returns the hidden state of the cell
-    bool hidden_status()
+    // Returns a block to the pool
+    void deallocate(void *pointer)
     {
-        return is_hidden;
+        Block *block = static_cast<Block *>(pointer);
+        block->next = freeList;
+        freeList = block;
+        live--;
+        available++;
+        COUNT_NODE_FREE();
     }
 
-    // Sets the x and y coordinates of the cell
-    void set_pos(int x, int y)
+    // Adds slabs until at least the given number of blocks can be handed out without allocating
+    void reserve(int blocks)
+    {
+        while (available < blocks)
+            add_slab();
+    }
+
+    // Returns the number of blocks in use
+    int get_live()
+    {
+        return live;
+    }
+
+    // Releases every slab at once, the blocks handed out before become invalid
+    void release()
+    {
+        while (slabs != nullptr)
+        {
+            Slab *next = slabs->next;
+            ::operator delete(slabs);
+            COUNT_BYTES(-(long long)slab_bytes());
+            slabs = next;
+        }
+        freeList = nullptr;
+        live = 0;
+        available = 0;
+    }
+};
+
+// Forward iterator over a chain of nodes linked through next, shared by the linked containers
+template <typename type, typename Node>
+class ChainIterator
+{
+private:
+    Node *node;
+
+public:
+    typedef forward_iterator_tag iterator_category;
+    typedef typename remove_const<type>::type value_type;
+    typedef ptrdiff_t difference_type;
+    typedef type *pointer;
+    typedef type &reference;
+
+    ChainIterator(Node *node = nullptr)
     {
-        pos.set_pos(x, y);
+        this->node = node;
     }
 
-    // Sets the x coordinate of the cell
-    void set_x(int x)
+    reference operator*() const
     {
-        pos.x = x;
+        return node->data;
     }
 
-    // Sets the y coordinate of the cell
-    void set_y(int y)
+    pointer operator->() const
     {
-        pos.y = y;
+        return &node->data;
     }
 
-    // Sets the symbol in the cell
-    void set_symbol(char symbol)
+    // Moves to the next node
+    ChainIterator &operator++()
     {
-        this->symbol = symbol;
-        if (symbol == 'K' || symbol == 'D')
-            is_hidden = true;
+        node = node->next;
+        COUNT_STEPS(1);
+        return *this;
+    }
+
+    ChainIterator operator++(int)
+    {
+        ChainIterator previous = *this;
+        ++*this;
+        return previous;
     }
 
-    // Sets the hidden state of the cell
-    void set_hidden(bool flag)
+    bool operator==(const ChainIterator &other) const
     {
-        is_hidden = flag;
+        return node == other.node;
+    }
+
+    bool operator!=(const ChainIterator &other) const
+    {
+        return node != other.node;
     }
 };
 
 // Implements a 1D list
+// Nodes are linked both ways, so elements can be added or removed at either end in constant time
 template <typename type>
 class List
 {
@@ -123,25 +323,120 @@ class List
     {
         type data;
         Node *next;
+        Node *prev;
+
+        // Builds the element in place from the given arguments
+        template <typename... Args>
+        explicit Node(Args &&...args) : data(std::forward<Args>(args)...)
+        {
+            next = nullptr;
+            prev = nullptr;
+        }
     };
     Node *head;
     Node *tail;
     int size;
+    NodePool ownPool; // Used when no shared pool is given
+    NodePool *pool;
+
+    // Creates a node from the pool, building its element in place from the given arguments
+    template <typename... Args>
+    Node *create_node(Args &&...args)
+    {
+        return new (pool->allocate(sizeof(Node))) Node(std::forward<Args>(args)...);
+    }
+
+    // Destroys a node and returns it to the pool
+    void destroy_node(Node *node)
+    {
+        node->~Node();
+        pool->deallocate(node);
+    }
+
+    // Returns the node at index, walking from whichever end is closer
+    Node *node_at(int index)
+    {
+        Node *current;
+        if (index < size / 2)
+        {
+            current = head;
+            for (int i = 0; i < index; i++)
+                current = current->next;
+            COUNT_STEPS(index);
+        }
+        else
+        {
+            current = tail;
+            for (int i = size - 1; i > index; i--)
+                current = current->prev;
+            COUNT_STEPS(size - 1 - index);
+        }
+        return current;
+    }
+
+    // Removes a node from the chain and destroys it
+    void unlink(Node *node)
+    {
+        if (node->prev != nullptr)
+            node->prev->next = node->next;
+        else
+            head = node->next;
+
+        if (node->next != nullptr)
+            node->next->prev = node->prev;
+        else
+            tail = node->prev;
+
+        destroy_node(node);
+        size--;
+    }
 
 public:
-    List()
+    typedef ChainIterator<type, Node> iterator;
+    typedef ChainIterator<const type, const Node> const_iterator;
+
+    // Size of a node, for sizing a pool shared between lists
+    static const size_t node_size = sizeof(Node);
+
+    List() : ownPool(sizeof(Node))
     {
         head = nullptr;
         tail = nullptr;
         size = 0;
+        pool = &ownPool;
+    }
+
+    // Creates a list that takes its nodes from a shared pool
+    explicit List(NodePool *shared) : List()
+    {
+        pool = shared;
+    }
+
+    List(const List &) = delete;
+    List &operator=(const List &) = delete;
+
+    ~List()
+    {
+        clear();
     }
 
     // Appends an element to end
-    void add(type data)
+    void add(const type &data)
+    {
+        emplace(data);
+    }
+
+    // Appends an element to end, moving it into the list
+    void add(type &&data)
+    {
+        emplace(std::move(data));
+    }
+
+    // Builds an element in place at the end from the given arguments and returns it
+    template <typename... Args>
+    type &emplace(Args &&...args)
     {
-        Node *newNode = new Node;
-        newNode->data = data;
-        newNode->next = nullptr;
+        Node *newNode = create_node(std::forward<Args>(args)...);
         if (head == nullptr)
         {
             head = newNode;
@@ -149,10 +444,12 @@ public:
         }
         else
         {
+            newNode->prev = tail;
             tail->next = newNode;
             tail = newNode;
         }
         size++;
+        return newNode->data;
     }
 
     // Inserts an element at index
@@ -161,26 +458,22 @@ public:
         if (index < 0 || index > size)
             throw std::out_of_range("Index out of range");
 
-        Node *newNode = new Node;
-        newNode->data = data;
-        if (index == 0)
-        {
-            newNode->next = head;
-            head = newNode;
-        }
-        else if (index == size - 1)
+        if (index == size)
         {
-            add(data);
-            size--;
+            emplace(std::move(data));
+            return;
         }
+
+        // Link the new node in front of the node currently at index
+        Node *current = node_at(index);
+        Node *newNode = create_node(std::move(data));
+        newNode->next = current;
+        newNode->prev = current->prev;
+        if (current->prev != nullptr)
+            current->prev->next = newNode;
         else
-        {
-            Node *current = head;
-            for (int i = 0; i < index - 1; i++)
-                current = current->next;
-            newNode->next = current->next;
-            current->next = newNode;
-        }
+            head = newNode;
+        current->prev = newNode;
         size++;
     }
 
@@ -196,29 +489,8 @@ public:
         if (isEmpty())
             throw std::out_of_range("List is empty");
 
-        type data;
-
-        if (head == tail)
-        {
-            data = head->data;
-            delete head;
-            head = nullptr;
-            tail = nullptr;
-        }
-        else
-        {
-            Node *current = head;
-
-            while (current->next != tail)
-                current = current->next;
-
-            data = tail->data;
-            delete tail;
-            tail = current;
-            tail->next = nullptr;
-        }
-
-        size--;
+        type data = std::move(tail->data);
+        unlink(tail);
         return data;
     }
 
@@ -228,119 +500,47 @@ public:
         if (index < 0 || index >= size)
             throw std::out_of_range("Index out of range");
 
-        type data;
-
-        if (index == 0)
-        {
-            Node *temp = head;
-            data = head->data;
-            head = head->next;
-            if (head == nullptr)
-                tail = nullptr;
-            delete temp;
-        }
-        else if (index == size - 1)
-        {
-            data = pop();
-            return data;
-        }
-        else
-        {
-            Node *current = head;
-            for (int i = 0; i < index - 1; i++)
-                current = current->next;
-
-            Node *temp = current->next;
-            data = temp->data;
-            current->next = temp->next;
-
-            if (temp == tail)
-                tail = current;
-
-            delete temp;
-        }
-
-        size--;
+        Node *current = node_at(index);
+        type data = std::move(current->data);
+        unlink(current);
         return data;
     }
 
     // Removes the first occurence of an element
-    void remove(type value)
+    void remove(const type &value)
     {
         if (isEmpty())
             throw std::out_of_range("List is empty");
 
-        Node *current = head;
-        Node *previous = nullptr;
-
-        // If the element to remove is the head
-        if (head->data == value)
-        {
-            head = head->next;
-            if (head == nullptr)
-                tail = nullptr;
-            delete current;
-            size--;
-            return;
-        }
-
         // Traverse the list to find the element
+        Node *current = head;
         while (current != nullptr && !(current->data == value))
         {
-            previous = current;
             current = current->next;
+            COUNT_STEPS(1);
         }
 
         // If the element is not found
         if (current == nullptr)
             throw std::invalid_argument("Element not found in the list");
 
-        previous->next = current->next;
-
-        if (current == tail)
-            tail = previous;
-
-        delete current;
-        size--;
+        unlink(current);
     }
 
     // Removes all occurences of an element
-    void remove_all(type value)
+    void remove_all(const type &value)
     {
         if (isEmpty())
             throw std::out_of_range("List is empty");
 
         Node *current = head;
-        Node *previous = nullptr;
-
         while (current != nullptr)
         {
+            Node *next = current->next;
             if (current->data == value)
-            {
-                Node *temp = current;
-
-                if (current == head)
-                {
-                    head = current->next;
-                    if (head == nullptr)
-                        tail = nullptr;
-                }
-                else
-                {
-                    previous->next = current->next;
-                    if (current == tail)
-                        tail = previous;
-                }
-
-                current = current->next;
-                delete temp;
-                size--;
-            }
-            else
-            {
-                previous = current;
-                current = current->next;
-            }
+                unlink(current);
+            current = next;
+            COUNT_STEPS(1);
         }
     }
 
@@ -350,152 +550,385 @@ public:
         if (index < 0 || index >= size)
             throw std::out_of_range("Index out of range");
 
-        Node *current = head;
-        for (int i = 0; i < index; i++)
-            current = current->next;
-
-        return current->data;
+        return node_at(index)->data;
     }
 
     // Returns if an element is present in the list
-    bool contains(type element)
+    bool contains(const type &element)
     {
-        Node *current = head;
-        while (current != nullptr)
-        {
-            if (current->data == element)
-                return true;
-            current = current->next;
-        }
-        return false;
+        return find(begin(), end(), element) != end();
     }
 
     // Clears the list
     void clear()
     {
-        while (!isEmpty())
-            pop();
+        while (head != nullptr)
+        {
+            Node *next = head->next;
+            destroy_node(head);
+            head = next;
+        }
+        tail = nullptr;
+        size = 0;
     }
 
     // Prints elements of list
     void print()
     {
-        Node *current = head;
-        while (current != nullptr)
-        {
-            cout << current->data << " ";
-            current = current->next;
-        }
+        for (const type &data : *this)
+            cout << data << " ";
         cout << endl;
     }
-};
 
-// Implements a stack
-template <typename type>
-class MutatedStack
-{
-private:
-    struct Node
+    // Returns an iterator to the first element
+    iterator begin()
     {
-        type data;
-        Node *next;
-    };
-    Node *top;
-    int size;
+        return iterator(head);
+    }
 
-public:
-    MutatedStack()
+    // Returns an iterator past the last element
+    iterator end()
     {
-        top = nullptr;
-        size = 0;
+        return iterator();
     }
 
-    // Pushes an element onto the stack
-    void push(type data)
+    const_iterator begin() const
     {
-        Node *newNode = new Node;
-        newNode->data = data;
-        newNode->next = top;
-        top = newNode;
-        size++;
+        return const_iterator(head);
     }
 
-    // Returns if the stack is empty
-    bool isEmpty()
+    const_iterator end() const
     {
-        return top == nullptr;
+        return const_iterator();
     }
 
-    // Pops and returns the top element from the stack
-    type pop()
+    // Makes room in the node pool for the given number of elements
+    void reserve(int count)
     {
-        if (isEmpty())
-            return type();
-
-        type data = top->data;
-        Node *temp = top;
-        top = top->next;
-        delete temp;
-        size--;
-        return data;
+        pool->reserve(count);
     }
+};
 
-    // Returns the top element from the stack
-    type peek()
-    {
-        if (isEmpty())
-            return type();
+// Implements a list that keeps its first capacity elements inside the object
+// Elements are stored contiguously and only move to the heap when the inline space runs out
+template <typename type, int capacity>
+class InlineList
+{
+private:
+    type inlineItems[capacity];
+    type *items; // Points at the inline items until the list overflows
+    int size;
+    int allocated;
 
-        return top->data;
+public:
+    typedef type *iterator;
+    typedef const type *const_iterator;
+
+    InlineList()
+    {
+        items = inlineItems;
+        size = 0;
+        allocated = capacity;
     }
 
-    // Returns if the stack contains the given element
-    bool contains(type element)
+    InlineList(const InlineList &) = delete;
+    InlineList &operator=(const InlineList &) = delete;
+
+    ~InlineList()
     {
-        Node *current = top;
-        while (current != nullptr)
+        if (items != inlineItems)
         {
-            if (current->data == element)
-                return true;
-            current = current->next;
+            delete[] items;
+            COUNT_BYTES(-(long long)allocated * sizeof(type));
         }
-        return false;
     }
 
-    // Removes the given element from the stack
-    void remove(type element)
+    // Makes room for the given number of elements, moving them to the heap if they do not fit inline
+    void reserve(int count)
     {
-        if (isEmpty())
-            return;
-
-        if (top->data == element)
-        {
-            pop();
+        if (count <= allocated)
             return;
-        }
 
-        Node *current = top;
-        Node *previous = nullptr;
+        type *newItems = new type[count];
+        COUNT_BYTES((long long)count * sizeof(type));
+        for (int i = 0; i < size; i++)
+            newItems[i] = std::move(items[i]);
 
-        while (current->next != nullptr && current->next->data != element)
+        if (items != inlineItems)
         {
-            previous = current;
-            current = current->next;
+            delete[] items;
+            COUNT_BYTES(-(long long)allocated * sizeof(type));
         }
+        items = newItems;
+        allocated = count;
+    }
 
-        if (current->next == nullptr)
+    // Appends an element to end
+    void add(const type &data)
+    {
+        emplace(data);
+    }
+
+    // Appends an element to end, moving it into the list
+    void add(type &&data)
+    {
+        emplace(std::move(data));
+    }
+
+    // Builds an element at the end from the given arguments and returns it
+    template <typename... Args>
+    type &emplace(Args &&...args)
+    {
+        if (size == allocated)
+            reserve(allocated * 2);
+
+        items[size] = type(std::forward<Args>(args)...);
+        return items[size++];
+    }
+
+    // Returns if the list is empty
+    bool isEmpty()
+    {
+        return size == 0;
+    }
+
+    // Returns the number of elements in the list
+    int get_size()
+    {
+        return size;
+    }
+
+    // Removes and returns the last element in the list
+    type pop()
+    {
+        if (isEmpty())
+            throw std::out_of_range("List is empty");
+
+        size--;
+        return std::move(items[size]);
+    }
+
+    // Removes the first occurence of an element, the elements after it keep their order
+    void remove(const type &value)
+    {
+        if (isEmpty())
+            throw std::out_of_range("List is empty");
+
+        type *found = find(begin(), end(), value);
+        COUNT_STEPS(found - begin());
+        if (found == end())
+            throw std::invalid_argument("Element not found in the list");
+
+        std::move(found + 1, end(), found);
+        size--;
+    }
+
+    // Returns an element at an index
+    type &at(int index)
+    {
+        if (index < 0 || index >= size)
+            throw std::out_of_range("Index out of range");
+
+        return items[index];
+    }
+
+    // Returns if an element is present in the list
+    bool contains(const type &element)
+    {
+        type *found = find(begin(), end(), element);
+        COUNT_STEPS(found - begin());
+        return found != end();
+    }
+
+    // Clears the list, the storage is kept for reuse
+    void clear()
+    {
+        size = 0;
+    }
+
+    iterator begin()
+    {
+        return items;
+    }
+
+    iterator end()
+    {
+        return items + size;
+    }
+
+    const_iterator begin() const
+    {
+        return items;
+    }
+
+    const_iterator end() const
+    {
+        return items + size;
+    }
+};
+
+// Implements a stack
+template <typename type>
+class MutatedStack
+{
+private:
+    struct Node
+    {
+        type data;
+        Node *next;
+
+        // Builds the element in place from the given arguments
+        template <typename... Args>
+        explicit Node(Args &&...args) : data(std::forward<Args>(args)...)
+        {
+            next = nullptr;
+        }
+    };
+    Node *top;
+    int size;
+    NodePool ownPool; // Used when no shared pool is given
+    NodePool *pool;
+
+    // Creates a node from the pool, building its element in place from the given arguments
+    template <typename... Args>
+    Node *create_node(Args &&...args)
+    {
+        return new (pool->allocate(sizeof(Node))) Node(std::forward<Args>(args)...);
+    }
+
+    // Destroys a node and returns it to the pool
+    void destroy_node(Node *node)
+    {
+        node->~Node();
+        pool->deallocate(node);
+    }
+
+public:
+    typedef ChainIterator<type, Node> iterator;
+    typedef ChainIterator<const type, const Node> const_iterator;
+
+    // Size of a node, for sizing a pool shared between stacks
+    static const size_t node_size = sizeof(Node);
+
+    MutatedStack() : ownPool(sizeof(Node))
+    {
+        top = nullptr;
+        size = 0;
+        pool = &ownPool;
+    }
+
+    // Creates a stack that takes its nodes from a shared pool
+    explicit MutatedStack(NodePool *shared) : MutatedStack()
+    {
+        pool = shared;
+    }
+
+    MutatedStack(const MutatedStack &) = delete;
+    MutatedStack &operator=(const MutatedStack &) = delete;
+
+    ~MutatedStack()
+    {
+        clear();
+    }
+
+    // Pushes an element onto the stack
+    void push(const type &data)
+    {
+        emplace(data);
+    }
+
+    // Pushes an element onto the stack, moving it into the stack
+    void push(type &&data)
+    {
+        emplace(std::move(data));
+    }
+
+    // Builds an element in place on top of the stack from the given arguments and returns it
+    template <typename... Args>
+    type &emplace(Args &&...args)
+    {
+        Node *newNode = create_node(std::forward<Args>(args)...);
+        newNode->next = top;
+        top = newNode;
+        size++;
+        return newNode->data;
+    }
+
+    // Returns if the stack is empty
+    bool isEmpty()
+    {
+        return top == nullptr;
+    }
+
+    // Pops and returns the top element from the stack
+    type pop()
+    {
+        if (isEmpty())
+            return type();
+
+        type data = std::move(top->data);
+        Node *temp = top;
+        top = top->next;
+        destroy_node(temp);
+        size--;
+        return data;
+    }
+
+    // Returns the top element from the stack, or a default element when the stack is empty
+    const type &peek()
+    {
+        static const type empty = type();
+        if (isEmpty())
+            return empty;
+
+        return top->data;
+    }
+
+    // Returns if the stack contains the given element
+    bool contains(const type &element)
+    {
+        return find(begin(), end(), element) != end();
+    }
+
+    // Removes the given element from the stack
+    void remove(const type &element)
+    {
+        if (isEmpty())
+            return;
+
+        if (top->data == element)
+        {
+            pop();
+            return;
+        }
+
+        Node *current = top;
+
+        while (current->next != nullptr && current->next->data != element)
+        {
+            current = current->next;
+            COUNT_STEPS(1);
+        }
+
+        if (current->next == nullptr)
             return;
 
-        previous->next = current->next;
-        delete current;
+        Node *temp = current->next;
+        current->next = temp->next;
+        destroy_node(temp);
         size--;
     }
 
     // Clears the stack
     void clear()
     {
-        while (!isEmpty())
-            pop();
+        while (top != nullptr)
+        {
+            Node *next = top->next;
+            destroy_node(top);
+            top = next;
+        }
+        size = 0;
     }
 
     // Returns the number of elements in the stack
@@ -507,35 +940,59 @@ public:
     // Prints the elements in the stack
     void print()
     {
-        Node *current = top;
-        while (current != nullptr)
-        {
-            cout << current->data << " ";
-            current = current->next;
-        }
+        for (const type &data : *this)
+            cout << data << " ";
         cout << endl;
     }
+
+    // Returns an iterator to the top element
+    iterator begin()
+    {
+        return iterator(top);
+    }
+
+    // Returns an iterator past the last element
+    iterator end()
+    {
+        return iterator();
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(top);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator();
+    }
+
+    // Makes room in the node pool for the given number of elements
+    void reserve(int count)
+    {
+        pool->reserve(count);
+    }
 };
 
+#ifndef MAZE_HEADLESS
 // Prints the stack containing position objects
 template <>
 void MutatedStack<Pos>::print()
 {
-    Node *current = top;
-    while (current != nullptr)
+    for (const Pos &pos : *this)
     {
-        current->data.print();
+        pos.print();
         printw(" ");
-        current = current->next;
     }
     printw("\n");
 }
+#endif
 
 #include <iostream>
-#include <ncurses.h> // Assuming you're using ncurses
 using namespace std;
 
 // Implements a queue
+// Nodes are linked both ways, so elements can be removed from either end in constant time
 template <typename type>
 class MutatedQueue
 {
@@ -544,25 +1001,82 @@ private:
     {
         type data;
         Node *next;
+        Node *prev;
+
+        // Builds the element in place from the given arguments
+        template <typename... Args>
+        explicit Node(Args &&...args) : data(std::forward<Args>(args)...)
+        {
+            next = nullptr;
+            prev = nullptr;
+        }
     };
     Node *front;
     Node *rear;
     int size;
+    NodePool ownPool; // Used when no shared pool is given
+    NodePool *pool;
+
+    // Creates a node from the pool, building its element in place from the given arguments
+    template <typename... Args>
+    Node *create_node(Args &&...args)
+    {
+        return new (pool->allocate(sizeof(Node))) Node(std::forward<Args>(args)...);
+    }
+
+    // Destroys a node and returns it to the pool
+    void destroy_node(Node *node)
+    {
+        node->~Node();
+        pool->deallocate(node);
+    }
 
 public:
-    MutatedQueue()
+    typedef ChainIterator<type, Node> iterator;
+    typedef ChainIterator<const type, const Node> const_iterator;
+
+    // Size of a node, for sizing a pool shared between queues
+    static const size_t node_size = sizeof(Node);
+
+    MutatedQueue() : ownPool(sizeof(Node))
     {
         front = nullptr;
         rear = nullptr;
         size = 0;
+        pool = &ownPool;
+    }
+
+    // Creates a queue that takes its nodes from a shared pool
+    explicit MutatedQueue(NodePool *shared) : MutatedQueue()
+    {
+        pool = shared;
+    }
+
+    MutatedQueue(const MutatedQueue &) = delete;
+    MutatedQueue &operator=(const MutatedQueue &) = delete;
+
+    ~MutatedQueue()
+    {
+        clear();
     }
 
     // Enqueues an element (adds to the rear)
-    void enqueue(type data)
+    void enqueue(const type &data)
+    {
+        emplace(data);
+    }
+
+    // Enqueues an element, moving it into the queue
+    void enqueue(type &&data)
     {
-        Node *newNode = new Node;
-        newNode->data = data;
-        newNode->next = nullptr;
+        emplace(std::move(data));
+    }
+
+    // Builds an element in place at the rear from the given arguments and returns it
+    template <typename... Args>
+    type &emplace(Args &&...args)
+    {
+        Node *newNode = create_node(std::forward<Args>(args)...);
 
         if (isEmpty())
         {
@@ -571,11 +1085,13 @@ public:
         }
         else
         {
+            newNode->prev = rear;
             rear->next = newNode;
             rear = newNode;
         }
 
         size++;
+        return newNode->data;
     }
 
     // Returns if the queue is empty
@@ -590,13 +1106,15 @@ public:
         if (isEmpty())
             return type();
 
-        type data = front->data;
+        type data = std::move(front->data);
         Node *temp = front;
         front = front->next;
         if (front == nullptr)
             rear = nullptr;
+        else
+            front->prev = nullptr;
 
-        delete temp;
+        destroy_node(temp);
         size--;
         return data;
     }
@@ -607,62 +1125,48 @@ public:
         if (isEmpty())
             return type();
 
-        type data = rear->data;
+        type data = std::move(rear->data);
         Node *temp = rear;
 
-        if (front == rear)
-        {
+        rear = rear->prev;
+        if (rear == nullptr)
             front = nullptr;
-            rear = nullptr;
-        }
         else
-        {
-            Node *current = front;
-            while (current->next != rear)
-                current = current->next;
-
-            rear = current;
             rear->next = nullptr;
-        }
 
-        delete temp;
+        destroy_node(temp);
         size--;
         return data;
     }
 
-    // Returns the front element
-    type peek_front()
+    // Returns the front element, or a default element when the queue is empty
+    const type &peek_front()
     {
+        static const type empty = type();
         if (isEmpty())
-            return type();
+            return empty;
 
         return front->data;
     }
 
-    // Returns the rear element
-    type peek_rear()
+    // Returns the rear element, or a default element when the queue is empty
+    const type &peek_rear()
     {
+        static const type empty = type();
         if (isEmpty())
-            return type();
+            return empty;
 
         return rear->data;
     }
 
     // Returns if the queue contains the given element
-    bool contains(type element)
+    bool contains(const type &element)
     {
-        Node *current = front;
-        while (current != nullptr)
-        {
-            if (current->data == element)
-                return true;
-            current = current->next;
-        }
-        return false;
+        return find(begin(), end(), element) != end();
     }
 
     // Removes the given element from the queue
-    void remove(type element)
+    void remove(const type &element)
     {
         if (isEmpty())
             return;
@@ -674,29 +1178,37 @@ public:
         }
 
         Node *current = front;
-        Node *previous = nullptr;
 
         while (current->next != nullptr && current->next->data != element)
         {
-            previous = current;
             current = current->next;
+            COUNT_STEPS(1);
         }
 
         if (current->next == nullptr)
             return;
 
-        previous->next = current->next;
-        if (current == rear)
-            rear = previous;
-        delete current;
+        Node *temp = current->next;
+        current->next = temp->next;
+        if (temp == rear)
+            rear = current;
+        else
+            temp->next->prev = current;
+        destroy_node(temp);
         size--;
     }
 
     // Clears the queue
     void clear()
     {
-        while (!isEmpty())
-            dequeue();
+        while (front != nullptr)
+        {
+            Node *next = front->next;
+            destroy_node(front);
+            front = next;
+        }
+        rear = nullptr;
+        size = 0;
     }
 
     // Returns the number of elements in the queue
@@ -708,251 +1220,1356 @@ public:
     // Prints the elements in the queue
     void print()
     {
-        Node *current = front;
-        while (current != nullptr)
-        {
-            cout << current->data << " ";
-            current = current->next;
-        }
+        for (const type &data : *this)
+            cout << data << " ";
         cout << endl;
     }
-};
 
-// Prints the queue containing the position objects
-template <>
-void MutatedQueue<Pos>::print()
-{
-    Node *current = front;
-    while (current != nullptr)
+    // Returns an iterator to the front element
+    iterator begin()
     {
-        current->data.print();
-        printw(" ");
-        current = current->next;
+        return iterator(front);
     }
-    printw("\n");
-}
 
-// Implements a 2D list for the maze game
-class TwoDlist
-{
+    // Returns an iterator past the last element
+    iterator end()
+    {
+        return iterator();
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(front);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator();
+    }
+
+    // Makes room in the node pool for the given number of elements
+    void reserve(int count)
+    {
+        pool->reserve(count);
+    }
+};
+
+#ifndef MAZE_HEADLESS
+// Prints the queue containing the position objects
+template <>
+void MutatedQueue<Pos>::print()
+{
+    for (const Pos &pos : *this)
+    {
+        pos.print();
+        printw(" ");
+    }
+    printw("\n");
+}
+#endif
+
+// Implements a growable ring buffer, used as a stack whose elements sit in one contiguous block
+// With a limit set, pushing onto a full buffer overwrites the oldest element instead of growing
+template <typename type>
+class RingBuffer
+{
 private:
-    struct Node
+    type *items;
+    int capacity;
+    int start; // Slot of the oldest element
+    int size;
+    int limit; // Maximum number of elements kept, 0 for no limit
+
+    // Returns the slot of the element at the given position from the oldest
+    int slot(int position)
+    {
+        return (start + position) % capacity;
+    }
+
+    // Makes room for one more element and returns its slot
+    type &next_slot()
+    {
+        if (limit > 0 && size == limit)
+        {
+            // Drop the oldest element to make room
+            type &item = items[slot(size)];
+            start = slot(1);
+            return item;
+        }
+
+        if (size == capacity)
+            reserve(capacity == 0 ? 16 : capacity * 2);
+
+        size++;
+        return items[slot(size - 1)];
+    }
+
+public:
+    RingBuffer()
+    {
+        items = nullptr;
+        capacity = 0;
+        start = 0;
+        size = 0;
+        limit = 0;
+    }
+
+    // Creates a buffer that keeps at most limit elements
+    explicit RingBuffer(int limit) : RingBuffer()
+    {
+        set_limit(limit);
+    }
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    ~RingBuffer()
+    {
+        delete[] items;
+        COUNT_BYTES(-(long long)capacity * sizeof(type));
+    }
+
+    // Makes room for at least the given number of elements so pushing does not allocate
+    void reserve(int count)
+    {
+        if (count <= capacity)
+            return;
+
+        type *newItems = new type[count];
+        COUNT_BYTES((long long)(count - capacity) * sizeof(type));
+        for (int i = 0; i < size; i++)
+            newItems[i] = std::move(items[slot(i)]);
+
+        delete[] items;
+        items = newItems;
+        capacity = count;
+        start = 0;
+    }
+
+    // Sets the maximum number of elements kept, dropping the oldest ones if there are more, 0 removes the limit
+    void set_limit(int limit)
+    {
+        this->limit = limit;
+        if (limit <= 0)
+            return;
+
+        while (size > limit)
+        {
+            start = slot(1);
+            size--;
+        }
+        reserve(limit);
+    }
+
+    // Pushes an element onto the buffer
+    void push(const type &data)
+    {
+        next_slot() = data;
+    }
+
+    // Pushes an element onto the buffer, moving it into its slot
+    void push(type &&data)
+    {
+        next_slot() = std::move(data);
+    }
+
+    // Builds an element from the given arguments on top of the buffer and returns it
+    template <typename... Args>
+    type &emplace(Args &&...args)
+    {
+        type &item = next_slot();
+        item = type(std::forward<Args>(args)...);
+        return item;
+    }
+
+    // Returns if the buffer is empty
+    bool isEmpty()
+    {
+        return size == 0;
+    }
+
+    // Pops and returns the newest element
+    type pop()
+    {
+        if (isEmpty())
+            return type();
+
+        size--;
+        return std::move(items[slot(size)]);
+    }
+
+    // Pops and returns the oldest element, so the buffer can serve as a queue as well
+    type pop_oldest()
+    {
+        if (isEmpty())
+            return type();
+
+        type item = std::move(items[start]);
+        start = slot(1);
+        size--;
+        return item;
+    }
+
+    // Returns the newest element, or a default element when the buffer is empty
+    const type &peek()
+    {
+        static const type empty = type();
+        if (isEmpty())
+            return empty;
+
+        return items[slot(size - 1)];
+    }
+
+    // Removes all the elements, the storage is kept for reuse
+    void clear()
+    {
+        start = 0;
+        size = 0;
+    }
+
+    // Returns the number of elements in the buffer
+    int get_size()
+    {
+        return size;
+    }
+
+    // Forward iterator over the elements, from the oldest to the newest
+    class iterator
+    {
+    private:
+        RingBuffer *buffer;
+        int position;
+
+    public:
+        typedef forward_iterator_tag iterator_category;
+        typedef type value_type;
+        typedef ptrdiff_t difference_type;
+        typedef type *pointer;
+        typedef type &reference;
+
+        iterator(RingBuffer *buffer = nullptr, int position = 0)
+        {
+            this->buffer = buffer;
+            this->position = position;
+        }
+
+        reference operator*() const
+        {
+            return buffer->items[buffer->slot(position)];
+        }
+
+        pointer operator->() const
+        {
+            return &**this;
+        }
+
+        iterator &operator++()
+        {
+            position++;
+            COUNT_STEPS(1);
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator previous = *this;
+            position++;
+            return previous;
+        }
+
+        bool operator==(const iterator &other) const
+        {
+            return position == other.position;
+        }
+
+        bool operator!=(const iterator &other) const
+        {
+            return position != other.position;
+        }
+    };
+
+    // Returns an iterator to the oldest element
+    iterator begin()
+    {
+        return iterator(this, 0);
+    }
+
+    // Returns an iterator past the newest element
+    iterator end()
+    {
+        return iterator(this, size);
+    }
+};
+
+// Implements a 2D list for the maze game
+// The symbols are kept row by row in one byte plane and the hidden flags in a separate bit plane,
+// so a cell is reached with a single index and whole rows or the whole grid can be hidden a word at a time
+class TwoDlist
+{
+private:
+    char *symbols;
+    uint64_t *hidden;
+    int current; // Index of the current cell, -1 when the list is empty
+    Pos currentPos;
+    int size;
+    char *frame;     // Glyphs drawn in the last frame, one per cell of the view
+    char *rowBuffer; // One composed row of the view, sent to the screen in a single call
+    Pos frameOrigin; // Screen row and column where the last frame was drawn
+    bool frameValid; // If the frame matches what is on the screen
+
+    // Part of the list shown on the screen, in frame coordinates where the border takes the outer ring
+    int viewTop, viewLeft;
+    int viewRows, viewCols;
+
+    // Returns the index of the given coordinates in the planes
+    int index_of(int x, int y)
+    {
+        return x * size + y;
+    }
+
+    // Returns the number of words in the hidden plane
+    int hidden_words()
+    {
+        return (size * size + 63) / 64;
+    }
+
+    // Sets the hidden bits in the range [begin, end) of the plane, one word at a time
+    void set_hidden_bits(int begin, int end, bool hide)
+    {
+        while (begin < end)
+        {
+            int offset = begin % 64;
+            int count = min(64 - offset, end - begin);
+            uint64_t mask = (count == 64 ? ~0ULL : ((1ULL << count) - 1)) << offset;
+
+            if (hide)
+                hidden[begin / 64] |= mask;
+            else
+                hidden[begin / 64] &= ~mask;
+
+            begin += count;
+        }
+    }
+
+    // Maps a cell state, the symbol in the low byte and the hidden flag above it, to the glyph shown
+    struct GlyphTable
+    {
+        char glyphs[512];
+
+        GlyphTable()
+        {
+            for (int symbol = 0; symbol < 256; symbol++)
+            {
+                glyphs[symbol] = (char)symbol;
+                glyphs[256 + symbol] = symbol == 'P' ? 'P' : '.'; // The player is never hidden
+            }
+        }
+    };
+
+    // Returns the shared glyph table
+    static const GlyphTable &glyph_table()
+    {
+        static const GlyphTable table;
+        return table;
+    }
+
+    // Returns the glyph shown for the cell at the given index
+    char glyph_of(int index)
+    {
+        int hiddenBit = (hidden[index / 64] >> (index % 64)) & 1;
+        return glyph_table().glyphs[(hiddenBit << 8) | (unsigned char)symbols[index]];
+    }
+
+    // Returns the glyph shown at the given row and column of the frame, the border takes the outer ring
+    char frame_glyph(int row, int col)
+    {
+        if (row == 0 || col == 0 || row == size + 1 || col == size + 1)
+            return '#';
+        return glyph_of(index_of(row - 1, col - 1));
+    }
+
+    // Resizes the view and the buffers that depend on it, the next print draws a full frame
+    void resize_view(int rows, int cols)
+    {
+        if (frame != nullptr && rows == viewRows && cols == viewCols)
+            return;
+
+        if (frame != nullptr)
+        {
+            delete[] frame;
+            delete[] rowBuffer;
+            COUNT_BYTES(-view_bytes());
+        }
+        viewRows = rows;
+        viewCols = cols;
+        frame = new char[rows * cols];
+        frameValid = false;
+
+        // Every glyph takes three columns, only the middle one changes between rows
+        rowBuffer = new char[cols * 3];
+        fill(rowBuffer, rowBuffer + cols * 3, ' ');
+        COUNT_BYTES(view_bytes());
+    }
+
+    // Returns the bytes held by the frame and the row buffer
+    long long view_bytes()
+    {
+        return (long long)viewRows * viewCols + viewCols * 3;
+    }
+
+    // Returns the bytes held by the symbol and hidden planes
+    long long plane_bytes()
+    {
+        return (long long)size * size + hidden_words() * sizeof(uint64_t);
+    }
+
+    // Frees the planes and the view buffers
+    void release_storage()
+    {
+        if (symbols != nullptr)
+            COUNT_BYTES(-plane_bytes());
+        if (frame != nullptr)
+            COUNT_BYTES(-view_bytes());
+
+        delete[] symbols;
+        delete[] hidden;
+        delete[] frame;
+        delete[] rowBuffer;
+        symbols = nullptr;
+        hidden = nullptr;
+        frame = nullptr;
+        rowBuffer = nullptr;
+        frameValid = false;
+        viewTop = viewLeft = 0;
+        viewRows = viewCols = 0;
+    }
+
+    // Stores a symbol at the current cell, newly added cells are always visible
+    void write_current(char symbol)
+    {
+        if (currentPos.x >= size || currentPos.y >= size)
+            throw std::out_of_range("Cell out of range");
+
+        current = index_of(currentPos.x, currentPos.y);
+        symbols[current] = symbol;
+        set_hidden_bits(current, current + 1, false);
+    }
+
+public:
+    TwoDlist()
+    {
+        symbols = nullptr;
+        hidden = nullptr;
+        current = -1;
+        currentPos.set_pos(0, 0);
+        size = 0;
+        frame = nullptr;
+        rowBuffer = nullptr;
+        frameValid = false;
+        viewTop = viewLeft = 0;
+        viewRows = viewCols = 0;
+    }
+
+    // Creates a size x size list filled with the given symbol
+    TwoDlist(int size, char symbol) : TwoDlist()
+    {
+        build(size, symbol);
+    }
+
+    ~TwoDlist()
+    {
+        release_storage();
+    }
+
+    // Sets the size of the list and allocates the planes for size x size cells
+    void set_size(int size)
+    {
+        release_storage();
+        this->size = size;
+        symbols = new char[size * size];
+        hidden = new uint64_t[hidden_words()]();
+        COUNT_BYTES(plane_bytes());
+
+        // The whole list is shown until a smaller view is set
+        resize_view(size + 2, size + 2);
+        current = -1;
+        currentPos.set_pos(0, 0);
+    }
+
+    // Lays out a size x size list filled with the given symbol in a single pass, the current pointer is left at the first cell
+    void build(int size, char symbol)
+    {
+        set_size(size);
+        fill(symbols, symbols + size * size, symbol);
+        move_to(0, 0);
+    }
+
+    // Adds an element to right of current pointer
+    void add_right(char symbol)
+    {
+        // If the list is empty, the element becomes the first cell
+        if (current == -1)
+            currentPos.set_pos(0, 0);
+        else
+            currentPos.y++;
+
+        write_current(symbol);
+    }
+
+    // Adds an element to down of current pointer
+    void add_down(char symbol)
+    {
+        // If the list is empty, the element becomes the first cell
+        if (current == -1)
+            currentPos.set_pos(0, 0);
+        else
+            currentPos.x++;
+
+        write_current(symbol);
+    }
+
+    // Clear the list
+    void clear()
+    {
+        release_storage();
+        current = -1;
+        currentPos.set_pos(0, 0);
+        size = 0;
+    }
+
+    // Moves the current pointer to the given coordinates
+    void move_to(int x, int y)
+    {
+        if (x < 0 || x >= size || y < 0 || y >= size)
+            return;
+
+        current = index_of(x, y);
+        currentPos.x = x;
+        currentPos.y = y;
+        COUNT_STEPS(1);
+    }
+
+    // Places a character at given coordinates, the key and the door are hidden when placed
+    void place_char(Pos pos, char symbol)
+    {
+        move_to(pos.x, pos.y);
+        symbols[current] = symbol;
+        if (symbol == 'K' || symbol == 'D')
+            set_hidden_bits(current, current + 1, true);
+    }
+
+    char get_char(Pos pos)
+    {
+        move_to(pos.x, pos.y);
+        return symbols[current];
+    }
+
+    // Hides or unhides the character at given coordinates
+    void set_hide(Pos pos, bool hide)
+    {
+        move_to(pos.x, pos.y);
+        set_hidden_bits(current, current + 1, hide);
+    }
+
+    // Returns if the character at given coordinates is hidden
+    bool is_hidden(Pos pos)
+    {
+        int index = index_of(pos.x, pos.y);
+        return (hidden[index / 64] >> (index % 64)) & 1;
+    }
+
+    // Hides or unhides the cells from column `from` to column `to` of a row
+    void set_hide_span(int row, int from, int to, bool hide)
+    {
+        if (from > to)
+            return;
+        set_hidden_bits(index_of(row, from), index_of(row, to) + 1, hide);
+    }
+
+    // Hides or unhides every cell of the list
+    void set_hide_all(bool hide)
+    {
+        fill(hidden, hidden + hidden_words(), hide ? ~0ULL : 0ULL);
+    }
+
+    // Shows at most rows x cols glyphs of the list on the screen, keeping the given cell as close to the middle as the edges allow
+    void set_view(Pos center, int rows, int cols)
+    {
+        rows = max(1, min(rows, size + 2));
+        cols = max(1, min(cols, size + 2));
+        resize_view(rows, cols);
+
+        // The cell is at row x + 1 and column y + 1 of the frame because of the border
+        viewTop = max(0, min(center.x + 1 - rows / 2, size + 2 - rows));
+        viewLeft = max(0, min(center.y + 1 - cols / 2, size + 2 - cols));
+    }
+
+#ifndef MAZE_HEADLESS
+    // Prints the 2D list at the cursor and remembers the frame for print_changes
+    void print_list()
+    {
+        if (current == -1)
+            return;
+
+        getyx(stdscr, frameOrigin.x, frameOrigin.y);
+
+        // Each row of the view is composed into the row buffer and written with one call
+        for (int row = 0; row < viewRows; row++)
+        {
+            for (int col = 0; col < viewCols; col++)
+            {
+                char glyph = frame_glyph(viewTop + row, viewLeft + col);
+                frame[row * viewCols + col] = glyph;
+                rowBuffer[col * 3 + 1] = glyph;
+            }
+            addnstr(rowBuffer, viewCols * 3);
+            addch('\n');
+        }
+        frameValid = true;
+        refresh();
+    }
+
+    // Redraws only the cells whose glyph changed since the last frame, the cursor is left below the list
+    // Falls back to a full print when there is no previous frame at the cursor position
+    void print_changes()
+    {
+        if (current == -1)
+            return;
+
+        Pos origin;
+        getyx(stdscr, origin.x, origin.y);
+        if (!frameValid || origin != frameOrigin)
+        {
+            print_list();
+            return;
+        }
+
+        // The frame is kept per screen cell, so scrolling the view is handled the same way as a change
+        for (int row = 0; row < viewRows; row++)
+            for (int col = 0; col < viewCols; col++)
+            {
+                char glyph = frame_glyph(viewTop + row, viewLeft + col);
+                if (frame[row * viewCols + col] == glyph)
+                    continue;
+
+                frame[row * viewCols + col] = glyph;
+                mvaddch(origin.x + row, origin.y + col * 3 + 1, glyph);
+            }
+
+        move(origin.x + viewRows, 0);
+        refresh();
+    }
+#endif
+};
+
+// Permuted congruential generator (PCG32), fast and small, with independent streams for the same seed
+class Random
+{
+private:
+    uint64_t state;
+    uint64_t increment; // Odd step of the generator, which picks the stream
+    uint64_t seed;
+    uint64_t stream;
+
+public:
+    explicit Random(uint64_t seed = 0, uint64_t stream = 0)
+    {
+        set_seed(seed, stream);
+    }
+
+    // Restarts the generator, the same seed and stream always give the same numbers
+    void set_seed(uint64_t seed, uint64_t stream = 0)
+    {
+        this->seed = seed;
+        this->stream = stream;
+        state = 0;
+        increment = (stream << 1) | 1;
+        next();
+        state += seed;
+        next();
+    }
+
+    // Returns the seed the generator was started with
+    uint64_t get_seed() const
+    {
+        return seed;
+    }
+
+    // Returns the stream the generator was started with
+    uint64_t get_stream() const
+    {
+        return stream;
+    }
+
+    // Returns the next 32 random bits
+    uint32_t next()
+    {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + increment;
+        uint32_t shifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+        uint32_t rotation = (uint32_t)(old >> 59);
+        return (shifted >> rotation) | (shifted << ((-rotation) & 31));
+    }
+
+    // Returns a number from 0 to bound - 1 with every value equally likely
+    int below(int bound)
+    {
+        // Skip the low values that would make the remainder favour small numbers
+        uint32_t threshold = (0u - (uint32_t)bound) % (uint32_t)bound;
+        while (true)
+        {
+            uint32_t value = next();
+            if (value >= threshold)
+                return value % (uint32_t)bound;
+        }
+    }
+
+    // Returns a seed that differs between runs, even when they start in the same second
+    static uint64_t fresh_seed()
+    {
+        random_device device;
+        return ((uint64_t)device() << 32) ^ device() ^ (uint64_t)time(nullptr);
+    }
+};
+
+// Cells of a board up to 64 wide, one word per row with a bit for every column
+class BitBoard
+{
+private:
+    uint64_t rows[64];
+    int size;
+
+public:
+    static const int max_size = 64;
+
+    explicit BitBoard(int size = 0)
+    {
+        clear(size);
+    }
+
+    // Empties the board and sets its size
+    void clear(int size)
+    {
+        this->size = size;
+        fill(rows, rows + max_size, 0);
+    }
+
+    // Sets or clears the cell at pos
+    void set(Pos pos, bool value = true)
+    {
+        if (value)
+            rows[pos.x] |= 1ULL << pos.y;
+        else
+            rows[pos.x] &= ~(1ULL << pos.y);
+    }
+
+    // Replaces the cells of row x, bit y is column y
+    void set_row(int x, uint64_t bits)
+    {
+        rows[x] = bits;
+    }
+
+    // Returns the cells of row x, bit y is column y
+    uint64_t row(int x) const
+    {
+        return rows[x];
+    }
+
+    // Returns if the cell at pos is set
+    bool test(Pos pos) const
+    {
+        return (rows[pos.x] >> pos.y) & 1;
+    }
+
+    // Moves a ring of a breadth first search one step outwards, to the cells of open next to it that are not in reached yet
+    // The ring lies between rows first and last, which are moved with it, and first passes last once the ring is empty
+    // Each row is grown with shifts, so a step costs a few word operations per row the ring touches
+    void grow_ring(const BitBoard &open, BitBoard &reached, int &first, int &last)
+    {
+        int from = max(first - 1, 0), to = min(last + 1, size - 1);
+        uint64_t above = 0;
+        first = size;
+        last = -1;
+        for (int x = from; x <= to; x++)
+        {
+            uint64_t current = rows[x], below = x + 1 < size ? rows[x + 1] : 0;
+            rows[x] = (current | current << 1 | current >> 1 | above | below) & open.rows[x] & ~reached.rows[x];
+            reached.rows[x] |= rows[x];
+            above = current;
+            if (rows[x] != 0)
+            {
+                first = min(first, x);
+                last = x;
+            }
+        }
+        COUNT_STEPS(to - from + 1);
+    }
+};
+
+// Shortest path lengths from one cell to every cell of a square board, stored row by row
+class DistanceField
+{
+private:
+    int *distances;
+    int size;
+
+    // Returns the bytes held by the distances
+    long long field_bytes() const
+    {
+        return (long long)size * size * sizeof(int);
+    }
+
+    // Sizes the field for the board and marks every cell unreachable
+    void reset(int size)
+    {
+        if (size != this->size)
+        {
+            COUNT_BYTES(-field_bytes());
+            delete[] distances;
+            distances = new int[size * size];
+            this->size = size;
+            COUNT_BYTES(field_bytes());
+        }
+        fill(distances, distances + size * size, unreachable);
+    }
+
+public:
+    enum { unreachable = -1 };
+
+    DistanceField()
+    {
+        distances = nullptr;
+        size = 0;
+    }
+
+    DistanceField(const DistanceField &) = delete;
+    DistanceField &operator=(const DistanceField &) = delete;
+
+    ~DistanceField()
+    {
+        COUNT_BYTES(-field_bytes());
+        delete[] distances;
+    }
+
+    // Fills the field with a breadth first search from source
+    // blocked takes the row major index of a cell and returns true for cells the search never steps onto
+    // frontier holds the cells waiting to be expanded, it only grows to the widest ring of the search and can be shared between fields
+    template <typename Blocked>
+    void build(int size, Pos source, Blocked blocked, RingBuffer<int> &frontier)
+    {
+        reset(size);
+        frontier.clear();
+        distances[source.x * size + source.y] = 0;
+        frontier.push(source.x * size + source.y);
+
+        while (!frontier.isEmpty())
+        {
+            int index = frontier.pop_oldest();
+            int x = index / size, y = index - x * size;
+            int next = distances[index] + 1;
+            COUNT_STEPS(1);
+
+            // Up, down, left and right, skipping the sides that leave the board
+            int neighbours[4] = {x > 0 ? index - size : -1, x < size - 1 ? index + size : -1,
+                                 y > 0 ? index - 1 : -1, y < size - 1 ? index + 1 : -1};
+            for (int i = 0; i < 4; i++)
+            {
+                int neighbour = neighbours[i];
+                if (neighbour < 0 || distances[neighbour] != unreachable || blocked(neighbour))
+                    continue;
+                distances[neighbour] = next;
+                frontier.push(neighbour);
+            }
+        }
+    }
+
+    // Fills the field on a board up to BitBoard::max_size wide, growing the search a whole ring at a time
+    // open holds the cells the search may step onto
+    void build(int size, Pos source, const BitBoard &open)
+    {
+        reset(size);
+
+        BitBoard ring(size), reached(size);
+        ring.set(source);
+        reached.set(source);
+        int first = source.x, last = source.x;
+        for (int distance = 0; first <= last; distance++)
+        {
+            for (int x = first; x <= last; x++)
+            {
+                for (uint64_t bits = ring.row(x); bits != 0; bits &= bits - 1)
+                    distances[x * size + __builtin_ctzll(bits)] = distance;
+            }
+            ring.grow_ring(open, reached, first, last);
+        }
+    }
+
+    // Returns the number of moves from the source to pos, or unreachable
+    int at(Pos pos) const
+    {
+        return distances[pos.x * size + pos.y];
+    }
+
+    // Returns if pos can be reached from the source
+    bool reaches(Pos pos) const
+    {
+        return at(pos) != unreachable;
+    }
+};
+
+// Result of solving a level
+struct Solution
+{
+    int moves;  // Fewest moves left on the history when the player wins, -1 when the level cannot be won
+    int budget; // Fewest moves the player has to be given to win, -1 when the level cannot be won
+};
+
+// Finds the best way through a freshly built level without playing it
+//
+// A move may not go straight back to the cell the player came from, so the search runs over states made of a
+// cell and the direction the player arrived from. Undoing a move refunds it, so the moves spent are always the
+// length of the history. Every win is then a walk from the start to some state, a detour from there to the key
+// that is undone again, and a walk on to the door. Each state is checked with three breadth first searches,
+// from the start and back from the key and the door.
+// Undos won from coins are not counted, so a level the solver can win can always be won.
+class LevelSolver
+{
+private:
+    static const int directions = 5; // Up, down, left, right, and none for the start before any move
+    static const int none = 4;
+
+    int *fromStart; // Moves from the start to every state
+    int *toKey;     // Moves from every state to the key
+    int *toDoor;    // Moves from every state to the door
+    int *frontier;
+    int capacity;
+    int size;
+    int best; // State where the win needing the fewest moves turns off to the key, -1 when there is none
+
+    // Returns the cell next to cell in direction, or -1 when it is off the board
+    int neighbour(int cell, int direction)
+    {
+        int x = cell / size, y = cell - x * size;
+        switch (direction)
+        {
+        case 0:
+            x--;
+            break;
+        case 1:
+            x++;
+            break;
+        case 2:
+            y--;
+            break;
+        case 3:
+            y++;
+            break;
+        }
+        if (x < 0 || x >= size || y < 0 || y >= size)
+            return -1;
+        return x * size + y;
+    }
+
+    // Returns the cell next to cell in direction, or -1 when it is off the board or blocked
+    template <typename Blocked>
+    int step(int cell, int direction, Blocked &blocked)
+    {
+        int next = neighbour(cell, direction);
+        if (next < 0 || blocked(next))
+            return -1;
+        return next;
+    }
+
+    // Visits the cells from state on, always stepping to a state one move closer in distances, until it reaches 0
+    template <typename Visit>
+    void follow(int state, int *distances, Visit &visit)
+    {
+        while (distances[state] > 0)
+        {
+            int cell = state / directions, arrival = state % directions;
+            for (int direction = 0; direction < 4; direction++)
+            {
+                int next = can_turn(arrival, direction) ? neighbour(cell, direction) : -1;
+                if (next >= 0 && distances[next * directions + direction] == distances[state] - 1)
+                {
+                    state = next * directions + direction;
+                    break;
+                }
+            }
+            visit(state / directions);
+        }
+    }
+
+    // Returns if a move in direction is allowed after arriving from arrival
+    static bool can_turn(int arrival, int direction)
+    {
+        return arrival == none || direction != (arrival ^ 1);
+    }
+
+    // Fills distances with the moves from the start to every state
+    template <typename Blocked>
+    void search_from(int start, int *distances, Blocked &blocked)
+    {
+        fill(distances, distances + size * size * directions, -1);
+        int head = 0, tail = 0;
+        distances[start * directions + none] = 0;
+        frontier[tail++] = start * directions + none;
+
+        while (head < tail)
+        {
+            int state = frontier[head++];
+            int cell = state / directions, arrival = state % directions;
+            COUNT_STEPS(1);
+            for (int direction = 0; direction < 4; direction++)
+            {
+                int next = can_turn(arrival, direction) ? step(cell, direction, blocked) : -1;
+                if (next < 0 || distances[next * directions + direction] >= 0)
+                    continue;
+                distances[next * directions + direction] = distances[state] + 1;
+                frontier[tail++] = next * directions + direction;
+            }
+        }
+    }
+
+    // Fills distances with the moves from every state to the target cell, searching backwards from it
+    template <typename Blocked>
+    void search_to(int target, int *distances, Blocked &blocked)
+    {
+        fill(distances, distances + size * size * directions, -1);
+        int head = 0, tail = 0;
+        for (int arrival = 0; arrival < directions; arrival++)
+        {
+            distances[target * directions + arrival] = 0;
+            frontier[tail++] = target * directions + arrival;
+        }
+
+        while (head < tail)
+        {
+            int state = frontier[head++];
+            int cell = state / directions, arrival = state % directions;
+            COUNT_STEPS(1);
+            if (arrival == none)
+                continue;
+
+            // The state was entered from the cell behind it, from any state there that may turn this way
+            int previous = step(cell, arrival ^ 1, blocked);
+            if (previous < 0)
+                continue;
+            for (int before = 0; before < directions; before++)
+            {
+                if (!can_turn(before, arrival) || distances[previous * directions + before] >= 0)
+                    continue;
+                distances[previous * directions + before] = distances[state] + 1;
+                frontier[tail++] = previous * directions + before;
+            }
+        }
+    }
+
+    // Returns the bytes held by the buffers
+    long long solver_bytes() const
+    {
+        return 4 * (long long)capacity * sizeof(int);
+    }
+
+    // Makes room for the states of a board of the given size
+    void reserve(int size)
     {
-        Cell cell;
-        Node *left;
-        Node *right;
-        Node *up;
-        Node *down;
-    };
-    Node *head;
-    Node *current;
-    Pos currentPos;
-    int size;
+        int states = size * size * directions;
+        if (states <= capacity)
+            return;
+
+        COUNT_BYTES(-solver_bytes());
+        delete[] fromStart;
+        delete[] toKey;
+        delete[] toDoor;
+        delete[] frontier;
+        fromStart = new int[states];
+        toKey = new int[states];
+        toDoor = new int[states];
+        frontier = new int[states];
+        capacity = states;
+        COUNT_BYTES(solver_bytes());
+    }
 
 public:
-    TwoDlist()
+    // Largest board the solver is used for, it keeps twenty ints for every cell
+    static const int max_size = 256;
+
+    LevelSolver()
     {
-        head = nullptr;
-        current = nullptr;
-        currentPos.set_pos(0, 0);
+        fromStart = toKey = toDoor = frontier = nullptr;
+        capacity = 0;
+        size = 0;
+        best = -1;
     }
 
-    void set_size(int size)
+    LevelSolver(const LevelSolver &) = delete;
+    LevelSolver &operator=(const LevelSolver &) = delete;
+
+    ~LevelSolver()
     {
-        this->size = size;
+        COUNT_BYTES(-solver_bytes());
+        delete[] fromStart;
+        delete[] toKey;
+        delete[] toDoor;
+        delete[] frontier;
     }
 
-    // Adds an element to right of current pointer
-    void add_right(char symbol)
+    // Solves a level before the player has moved, blocked takes the row major index of a cell and returns true for walls and bombs
+    // The buffers are kept between calls, so solving many levels of one size does not allocate
+    template <typename Blocked>
+    Solution solve(int size, Pos start, Pos key, Pos door, int undos, Blocked blocked)
     {
-        Node *newNode = new Node;
-        newNode->cell = Cell(currentPos.x, currentPos.y + 1, symbol);
-        newNode->left = nullptr;
-        newNode->right = nullptr;
-        newNode->up = nullptr;
-        newNode->down = nullptr;
+        this->size = size;
+        reserve(size);
 
-        // If the list is empty, set the newNode as the head, tail, and current
-        if (current == nullptr)
-        {
-            head = newNode;
-            current = newNode;
-        }
-        else
-        {
-            // Link the new node to the current node
-            newNode->left = current;
-            newNode->right = current->right;
-            current->right = newNode;
+        search_from(start.x * size + start.y, fromStart, blocked);
+        search_to(key.x * size + key.y, toKey, blocked);
+        search_to(door.x * size + door.y, toDoor, blocked);
 
-            if (newNode->right != nullptr)
-                newNode->right->left = newNode;
+        Solution solution = {-1, -1};
+        best = -1;
+        for (int state = 0; state < size * size * directions; state++)
+        {
+            // The detour to the key has to be undone, one undo per move
+            if (fromStart[state] < 0 || toKey[state] < 0 || toKey[state] > undos || toDoor[state] < 0)
+                continue;
 
-            newNode->up = (current->up != nullptr) ? current->up->right : nullptr;
-            if (newNode->up != nullptr)
-                newNode->up->down = newNode;
+            int moves = fromStart[state] + toDoor[state];
+            if (solution.moves < 0 || moves < solution.moves)
+                solution.moves = moves;
 
-            newNode->down = (current->down != nullptr) ? current->down->right : nullptr;
-            if (newNode->down != nullptr)
-                newNode->down->up = newNode;
-            current->cell.set_y(current->cell.get_pos().y + 1);
-            current = newNode;
+            // Reaching the key on the last move loses, reaching the door on it wins
+            int budget = max(fromStart[state] + toKey[state] + 1, moves);
+            if (solution.budget < 0 || budget < solution.budget)
+            {
+                solution.budget = budget;
+                best = state;
+            }
         }
+
+        if (solution.budget < 0)
+            best = -1;
+        return solution;
     }
 
-    // Adds an element to down of current pointer
-    void add_down(char symbol)
+    // Visits every cell the player steps on in the win needing the fewest moves found by the last solve
+    // Cells may be visited more than once
+    template <typename Visit>
+    void trace(Visit visit)
     {
-        Node *newNode = new Node;
-        newNode->cell = Cell(currentPos.x + 1, currentPos.y, symbol);
-        newNode->left = nullptr;
-        newNode->right = nullptr;
-        newNode->up = nullptr;
-        newNode->down = nullptr;
+        if (best < 0)
+            return;
 
-        // If the list is empty, set the newNode as the head, tail, and current
-        if (current == nullptr)
+        // Walk back to the start, then on to the key and to the door
+        int state = best;
+        visit(state / directions);
+        while (fromStart[state] > 0)
         {
-            head = newNode;
-            current = newNode;
+            int cell = state / directions, arrival = state % directions;
+            int previous = neighbour(cell, arrival ^ 1);
+            for (int before = 0; before < directions; before++)
+            {
+                if (can_turn(before, arrival) && fromStart[previous * directions + before] == fromStart[state] - 1)
+                {
+                    state = previous * directions + before;
+                    break;
+                }
+            }
+            visit(state / directions);
         }
-        else
-        {
-            // Link the new node to the current node
-            newNode->up = current;
-            newNode->down = current->down;
-            current->down = newNode;
+        follow(best, toKey, visit);
+        follow(best, toDoor, visit);
+    }
+};
 
-            if (newNode->down != nullptr)
-                newNode->down->up = newNode;
+// Finds a way through a freshly built level on boards too large for LevelSolver
+//
+// The same rule holds that a move may not go straight back, so the search runs over states made of a cell, the
+// direction the player arrived from and whether the key is held. It stops at the first state that reaches the door
+// with the key, which is a win with the fewest moves that never undoes. Each state only keeps the state it was
+// reached from, in four bits, so a cell costs four bytes.
+class RouteFinder
+{
+private:
+    static const int none = 4;         // Direction of the start before any move
+    static const unsigned unseen = 15; // Parent of a state not reached yet
 
-            newNode->left = (current->left != nullptr) ? current->left->down : nullptr;
-            if (newNode->left != nullptr)
-                newNode->left->right = newNode;
+    uint32_t *parents; // Eight states of four bits per cell, indexed by key held * 4 + arrival
+    RingBuffer<int> frontier;
+    int capacity;
+    int size;
+    int keyCell;
+    int doorCell;
+    int found; // State that reaches the door with the key, -1 when there is none
 
-            newNode->right = (current->right != nullptr) ? current->right->down : nullptr;
-            if (newNode->right != nullptr)
-                newNode->right->left = newNode;
-            current->cell.set_x(current->cell.get_pos().x + 1);
-            current = newNode;
-        }
+    // Returns the parent of a state, as key held * 5 + arrival of the state before
+    unsigned parent(int state)
+    {
+        return (parents[state >> 3] >> ((state & 7) * 4)) & 15;
     }
 
-    // Clear the list
-    void clear()
+    // Sets the parent of a state
+    void set_parent(int state, unsigned value)
     {
-        Node *current = head;
-        Node *row = head;
+        uint32_t &slot = parents[state >> 3];
+        slot = (slot & ~(15u << ((state & 7) * 4))) | (value << ((state & 7) * 4));
+    }
 
-        while (row != nullptr)
+    // Returns the cell next to cell in direction, or -1 when it is off the board
+    int neighbour(int cell, int direction)
+    {
+        int x = cell / size, y = cell - x * size;
+        switch (direction)
         {
-            Node *temp = row;
-            row = row->down;
-            while (temp != nullptr)
-            {
-                Node *next = temp->right;
-                delete temp;
-                temp = next;
-            }
+        case 0:
+            x--;
+            break;
+        case 1:
+            x++;
+            break;
+        case 2:
+            y--;
+            break;
+        case 3:
+            y++;
+            break;
         }
-        head = nullptr;
-        current = nullptr;
-        currentPos.set_pos(0, 0);
-        size = 0;
+        if (x < 0 || x >= size || y < 0 || y >= size)
+            return -1;
+        return x * size + y;
     }
 
-    // Moves the current pointer to the given coordinates
-    void move_to(int x, int y)
+    // Queues the states one move on from a cell, stopping at the first that reaches the door with the key
+    template <typename Blocked>
+    void expand(int cell, int held, int arrival, Blocked &blocked)
     {
-        Node *temp = head;
-
-        for (int i = 0; i < size; i++)
+        COUNT_STEPS(1);
+        for (int direction = 0; direction < 4; direction++)
         {
-            for (int j = 0; j < size; j++)
+            if (arrival != none && direction == (arrival ^ 1))
+                continue;
+            int next = neighbour(cell, direction);
+            if (next < 0 || blocked(next))
+                continue;
+
+            int nextHeld = held || next == keyCell;
+            int state = next * 8 + nextHeld * 4 + direction;
+            if (parent(state) != unseen)
+                continue;
+            set_parent(state, held * 5 + arrival);
+
+            if (nextHeld && next == doorCell)
             {
-                if (i == x && j == y)
-                {
-                    current = temp;
-                    currentPos.x = x;
-                    currentPos.y = y;
-                    return;
-                }
-                if (temp->right)
-                    temp = temp->right;
+                found = state;
+                return;
             }
-            temp = head;
-            for (int j = 0; j <= i; j++)
-                if (temp->down)
-                    temp = temp->down;
+            frontier.push(state);
         }
     }
 
-    // Places a character at given coordinates
-    void place_char(Pos pos, char symbol)
+    // Returns the bytes held by the parents
+    long long finder_bytes() const
     {
-        move_to(pos.x, pos.y);
-        current->cell.set_symbol(symbol);
+        return (long long)capacity * sizeof(uint32_t);
     }
 
-    char get_char(Pos pos)
+    // Makes room for the states of a board of the given size
+    void reserve(int size)
     {
-        move_to(pos.x, pos.y);
-        return current->cell.get_symbol();
+        int cells = size * size;
+        if (cells <= capacity)
+            return;
+
+        COUNT_BYTES(-finder_bytes());
+        delete[] parents;
+        parents = new uint32_t[cells];
+        capacity = cells;
+        COUNT_BYTES(finder_bytes());
     }
 
-    // Hides or unhides the character at given coordinates
-    void set_hide(Pos pos, bool hide)
+public:
+    RouteFinder()
     {
-        move_to(pos.x, pos.y);
-        current->cell.set_hidden(hide);
+        parents = nullptr;
+        capacity = 0;
+        size = 0;
+        keyCell = doorCell = -1;
+        found = -1;
     }
 
-    // Prints the 2D list
-    void print_list()
+    RouteFinder(const RouteFinder &) = delete;
+    RouteFinder &operator=(const RouteFinder &) = delete;
+
+    ~RouteFinder()
     {
-        if (head == nullptr)
+        COUNT_BYTES(-finder_bytes());
+        delete[] parents;
+    }
+
+    // Frees the states until the next solve, which forgets the win found
+    void release()
+    {
+        COUNT_BYTES(-finder_bytes());
+        delete[] parents;
+        parents = nullptr;
+        capacity = 0;
+        found = -1;
+    }
+
+    // Finds the win with the fewest moves that never undoes, blocked takes the row major index of a cell and returns true for walls and bombs
+    // Both the moves and the budget of the solution are its length, since no move is ever undone
+    template <typename Blocked>
+    Solution solve(int size, Pos start, Pos key, Pos door, Blocked blocked)
+    {
+        this->size = size;
+        keyCell = key.x * size + key.y;
+        doorCell = door.x * size + door.y;
+        reserve(size);
+        fill(parents, parents + size * size, ~(uint32_t)0);
+
+        // The start is the only state arriving from none, it is expanded first and never stored
+        found = -1;
+        frontier.clear();
+        expand(start.x * size + start.y, 0, none, blocked);
+        while (!frontier.isEmpty() && found < 0)
+        {
+            int state = frontier.pop_oldest();
+            expand(state >> 3, (state >> 2) & 1, state & 3, blocked);
+        }
+
+        if (found < 0)
+            return Solution{-1, -1};
+
+        int moves = 0;
+        trace([&moves](int)
+              { moves++; });
+        return Solution{moves - 1, moves - 1};
+    }
+
+    // Visits every cell the player steps on in the win found by the last solve, from the door back to the start
+    // Cells may be visited more than once
+    template <typename Visit>
+    void trace(Visit visit)
+    {
+        if (found < 0)
             return;
 
-        Node *row = head;
-        int x = 0, y = 0;
-        while (row != nullptr) // Traverse rows
+        int state = found;
+        while (true)
         {
-            x = 0;
-            Node *current = row;
-            if (row == head)
-            {
-                for (int i = 0; i < size + 2; i++)
-                    printw(" # ");
-                printw("\n");
-            }
-            while (current != nullptr) // Traverse columns
-            {
-                if (current == row)
-                    printw(" # ");
-                if (!current->cell.hidden_status())
-                    printw(" %c", current->cell.get_symbol());
-                else if (current->cell.get_symbol() == 'P')
-                    printw(" %c", current->cell.get_symbol());
-                else
-                    printw(" .");
-                printw(" ");
-
-                if (x == size - 1)
-                    printw(" # ");
-                current = current->right;
-                x++;
-            }
-            printw("\n");
-            if (y == size - 1)
+            int cell = state >> 3;
+            visit(cell);
+
+            unsigned before = parent(state);
+            int previous = neighbour(cell, (state & 3) ^ 1);
+            if (before % 5 == none)
             {
-                for (int i = 0; i < size + 2; i++)
-                    printw(" # ");
-                printw("\n");
+                visit(previous);
+                return;
             }
-            row = row->down; // Move down to the next row
-            y++;
+            state = previous * 8 + (before / 5) * 4 + before % 5;
         }
-        refresh();
     }
 };
 
@@ -973,7 +2590,7 @@ private:
         Pos current;
     };
 
-    MutatedStack<Move> moves_stack;
+    RingBuffer<Move> moves_stack; // Move history, kept in one block so a step does not allocate
 
 public:
     Player()
@@ -985,6 +2602,19 @@ public:
         score = 0;
     }
 
+    // Puts the player back to the start of a level, dropping the coins, moves and history of an earlier one
+    void reset()
+    {
+        key_state = false;
+        pos.set_pos(0, 0);
+        moves = 0;
+        undos = 0;
+        score = 0;
+        while (!collectedCoins.isEmpty())
+            collectedCoins.dequeue();
+        moves_stack.clear();
+    }
+
     // Sets the position of the player
     void set_pos(Pos pos)
     {
@@ -1082,6 +2712,12 @@ public:
         this->distance = distance;
     }
 
+    // Makes room in the moves list for the given number of moves
+    void reserve_moves(int count)
+    {
+        moves_stack.reserve(count);
+    }
+
     // Adds the move to the moves list
     void add_move(Pos previous, Pos current)
     {
@@ -1123,11 +2759,13 @@ public:
         return moves_stack.isEmpty();
     }
 
+#ifndef MAZE_HEADLESS
     // Prints the positions of the collected coins
     void print_coins()
     {
         collectedCoins.print();
     }
+#endif
 
     // Calculates the score after game end
     void calculate_score()
@@ -1136,6 +2774,33 @@ public:
     }
 };
 
+// Commands the player gives the game
+enum class Command
+{
+    up,
+    down,
+    left,
+    right,
+    undo,
+    none
+};
+
+// Things that happen in one step of the game, combined as bit flags
+struct Event
+{
+    static const unsigned moved = 1;      // The player stepped onto another cell
+    static const unsigned undone = 2;     // The last move was taken back
+    static const unsigned backtrack = 4;  // The move was refused because it went straight back
+    static const unsigned key = 8;        // The key was collected
+    static const unsigned coin = 16;      // A coin was collected
+    static const unsigned closer = 32;    // The player got closer to the key, or to the door once holding the key
+    static const unsigned bomb = 64;      // The game ended on a bomb
+    static const unsigned no_moves = 128; // The game ended with no moves left
+    static const unsigned won = 256;      // The game ended at the door with the key
+    static const unsigned over = bomb | no_moves | won;
+};
+
+// The rules of the game, driven by commands and never touching the terminal
 class Grid
 {
 private:
@@ -1143,17 +2808,55 @@ private:
     Pos door;
     Pos key;
     Player player;
-    List<Pos> coins;
-    List<Pos> bombs;
+    unsigned char *items; // Item flags of every cell stored row by row, so finding an item is a single lookup
     int size;
+    Pos fog_center; // Player position when the fog was last updated
+    int fog_radius; // Visibility radius when the fog was last updated, negative before the first update
+    DistanceField key_field;  // Shortest paths around the bombs from the key, built once per level
+    DistanceField door_field; // Shortest paths around the bombs from the door
+    RingBuffer<int> frontier; // Search queue shared by both fields, they are never built at the same time
+    Random random;            // Source of every random choice, so a seed rebuilds the same level
+    LevelSolver solver;
+    RouteFinder finder; // Takes over from the solver on boards it is too large for
+    Solution solution;  // The level solved with its bombs when it was built
+    int level;
+    unsigned outcome; // Event that ended the game, 0 while it is running
+    bool closer;      // If the last step brought the player closer to the goal
 
 public:
-    Grid() {}
+    static const unsigned char coin_flag = 1;
+    static const unsigned char bomb_flag = 2;
+    static const unsigned char wall_flag = 4;
+    static const unsigned char route_flag = 8; // Only set while the level is being built
+    static const int max_attempts = 64;        // Levels drawn before the game settles for one it cannot win
+
+    Grid()
+    {
+        items = nullptr;
+        fog_radius = -1;
+        level = 0;
+        outcome = 0;
+        closer = false;
+        solution = Solution{-1, -1};
+    }
+
+    Grid(const Grid &) = delete;
+    Grid &operator=(const Grid &) = delete;
+
+    ~Grid()
+    {
+        delete[] items;
+    }
 
     // Initializes the grid with player position, key and door positions, and coins and bombs positions based on current player level
-    void initialize_grid(int level)
+    // The custom level uses a board of customSize x customSize
+    void initialize_grid(int level, int customSize = 0)
     {
-        srand(time(nullptr));
+        this->level = level;
+        outcome = 0;
+        closer = false;
+        fog_radius = -1;
+        player.reset();
 
         int no_coins = 0;
         int no_bombs = 0;
@@ -1163,7 +2866,6 @@ public:
         case 1:
             // Sets the size of board to 10
             size = 10;
-            grid.set_size(10);
 
             // Sets the number of coins and bombs to 3
             no_coins = 3;
@@ -1176,7 +2878,6 @@ public:
         case 2:
             // Sets the size of board to 15
             size = 15;
-            grid.set_size(15);
 
             // Sets the number of coins and bombs to 5
             no_coins = 5;
@@ -1189,7 +2890,6 @@ public:
         case 3:
             // Sets the size of board to 20
             size = 20;
-            grid.set_size(20);
 
             // Sets the number of coins and bombs to 8
             no_coins = 8;
@@ -1198,102 +2898,380 @@ public:
             // Grant 1 undo move
             player.set_undos(1);
             break;
+
+        case 4:
+            // Sets the size of board to the size chosen by the player
+            size = customSize;
+
+            // Sets the number of coins and bombs to grow with the area of the board, as many per cell as medium
+            no_coins = max(3, size * size / 45);
+            no_bombs = max(3, size * size / 45);
+
+            // Grant 2 undo moves
+            player.set_undos(2);
+            break;
         }
 
-        // Generates a 2D list of given size
-        for (int i = 0; i < size; i++)
+        // Generates a 2D list of given size, walled everywhere until the maze is carved
+        grid.build(size, '#');
+        delete[] items;
+        items = new unsigned char[size * size];
+        fill(items, items + size * size, (unsigned char)wall_flag);
+
+        carve_maze();
+        braid_maze();
+
+        // Every item takes an open cell of its own
+        int *cells = new int[size * size];
+        int no_cells = 0;
+        for (int i = 0; i < size * size; i++)
+            if (!(items[i] & wall_flag))
+                cells[no_cells++] = i;
+
+        int no_items = 3 + no_coins + no_bombs;
+        if (no_items > no_cells)
         {
-            grid.add_down('.');
-            for (int j = 0; j < size - 1; j++)
-                grid.add_right('.');
-            grid.move_to(i, 0);
+            delete[] cells;
+            throw std::invalid_argument("Board is too small for its items");
         }
 
+        // Shuffles only the front of the open cells, so each item costs one swap and never has to be redrawn
+        // Each item is drawn from the cells not drawn yet up to end
+        int drawn = 0;
+        auto next_cell = [&](int end)
+        {
+            swap(cells[drawn], cells[drawn + random.below(end - drawn)]);
+            int cell = cells[drawn++];
+            return Pos(cell / size, cell % size);
+        };
 
         // Generate position of door
-        door.set_pos(rand() % size, rand() % size);
+        door = next_cell(no_cells);
         grid.place_char(door, 'D');
 
         // Generate position of key
-        do
-        {
-            key.set_pos(rand() % size, rand() % size);
-        } while (key == door);
+        key = next_cell(no_cells);
         grid.place_char(key, 'K');
 
         // Generate position of player
-        do
-        {
-            player.set_pos(Pos(rand() % size, rand() % size));
-        } while (player.get_pos() == key || player.get_pos() == door);
+        player.set_pos(next_cell(no_cells));
         grid.place_char(player.get_pos(), 'P');
 
+        // Move the cells on the way the player wins behind the others
+        // Bombs are drawn from the cells before split while there are any, so they never cut the way off
+        mark_route(true);
+        int split = partition(cells + drawn, cells + no_cells, [this](int cell)
+                              { return !(items[cell] & route_flag); }) -
+                    cells;
+
         // Generate positions of coins
         for (int i = 0; i < no_coins; i++)
         {
-            Pos coin;
-            do
-            {
-                coin.set_pos(rand() % size, rand() % size);
-            } while (coin == door || coin == key || coin == player.get_pos() || coins.contains(coin));
-            coins.add(coin);
+            Pos coin = next_cell(no_cells);
+            set_item(coin, coin_flag, true);
             grid.place_char(coin, 'C');
         }
 
         // Generate positions of bombs
         for (int i = 0; i < no_bombs; i++)
         {
-            Pos bomb;
-            do
-            {
-                bomb.set_pos(rand() % size, rand() % size);
-            } while (bomb == door || bomb == key || bomb == player.get_pos() || bombs.contains(bomb) || coins.contains(bomb));
-            bombs.add(bomb);
+            Pos bomb = next_cell(drawn < split ? split : no_cells);
+            set_item(bomb, bomb_flag, true);
             grid.place_char(bomb, 'B');
         }
+        delete[] cells;
+
+        mark_route(false);
+
+        // Solved before the distance fields are built, so the largest boards never hold the route finder and the fields at once
+        solution = solve();
+        finder.release();
+
+        build_distances();           // Measures the shortest paths to the key and the door
+        calculate_init_moves(level); // Calculates the initial moves given to player according to level
+        hide_cells(level); // Hides all cells except for those around the player
+        player.set_distance(goal_distance());
+        closer = false;
+    }
+
+    // Initializes the grid with a level that can be won, drawing it again from the next stream of the generator while it cannot
+    // Returns false when none of the attempts can be won, the last one is kept
+    bool initialize_solvable_grid(int level, int customSize = 0)
+    {
+        uint64_t seed = random.get_seed(), stream = random.get_stream();
+        for (int attempt = 0; attempt < max_attempts; attempt++)
+        {
+            random.set_seed(seed, stream + attempt);
+            initialize_grid(level, customSize);
+            if (is_solvable())
+                return true;
+        }
+        return false;
+    }
+
+    // Returns if the cell holds any of the items in flags
+    bool has_item(Pos pos, unsigned char flags)
+    {
+        return items[pos.x * size + pos.y] & flags;
+    }
+
+    // Adds or removes the items in flags at the cell
+    void set_item(Pos pos, unsigned char flags, bool present)
+    {
+        if (present)
+            items[pos.x * size + pos.y] |= flags;
+        else
+            items[pos.x * size + pos.y] &= ~flags;
+    }
+
+    // Sets the generator used to build the next level
+    void set_random(const Random &random)
+    {
+        this->random = random;
+    }
+
+    // Sets the size of the grid
+    void set_size(int size)
+    {
+        this->size = size;
+        grid.set_size(size);
+    }
+
+    // Returns the size of the grid
+    int get_size()
+    {
+        return size;
+    }
+
+    // Returns the position of the door
+    Pos get_door()
+    {
+        return door;
+    }
+
+    // Returns the position of the key
+    Pos get_key()
+    {
+        return key;
+    }
+
+    // Returns the player
+    Player &get_player()
+    {
+        return player;
+    }
+
+    // Returns the generator the level was built with
+    const Random &get_random()
+    {
+        return random;
+    }
+
+    // Returns the shortest paths around the bombs from the key, built with the level
+    const DistanceField &get_key_field()
+    {
+        return key_field;
+    }
+
+    // Returns the shortest paths around the bombs from the door, built with the level
+    const DistanceField &get_door_field()
+    {
+        return door_field;
+    }
+
+    // Solves the level as it was built, before the player has moved
+    // Boards larger than the solver takes get the shortest win that never undoes from the route finder
+    Solution solve()
+    {
+        auto isBlocked = [this](int index)
+        { return (items[index] & (bomb_flag | wall_flag)) != 0; };
+        if (size > LevelSolver::max_size)
+            return finder.solve(size, player.get_pos(), key, door, isBlocked);
+        return solver.solve(size, player.get_pos(), key, door, player.get_undos(), isBlocked);
+    }
+
+    // Returns if the level as built can be won with the moves and undos the player is given
+    bool is_solvable()
+    {
+        return solution.budget >= 0 && solution.budget <= player.get_moves();
+    }
+
+    // Opens a cell of the maze
+    void open_cell(int x, int y)
+    {
+        set_item(Pos(x, y), wall_flag, false);
+        grid.place_char(Pos(x, y), '.');
+    }
+
+    // Carves a maze with an iterative backtracker
+    // Rooms sit on even rows and columns and the cells between two rooms are the walls that can be opened
+    // On boards of even size the last row and column are left open as a corridor along the edge
+    void carve_maze()
+    {
+        int side = (size + 1) / 2; // Rooms per row and column
+        unsigned char *visited = new unsigned char[side * side]();
+        int *path = new int[side * side]; // Rooms from the start to the current one, the search backs up along it
+        int length = 0;
+
+        int start = random.below(side * side);
+        visited[start] = 1;
+        path[length++] = start;
+        open_cell(start / side * 2, start % side * 2);
+
+        const int dx[4] = {-1, 1, 0, 0};
+        const int dy[4] = {0, 0, -1, 1};
+        while (length > 0)
+        {
+            int room = path[length - 1];
+            int x = room / side, y = room % side;
+
+            // Collect the directions that lead to rooms not carved yet
+            int directions[4];
+            int count = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                int nx = x + dx[i], ny = y + dy[i];
+                if (nx >= 0 && nx < side && ny >= 0 && ny < side && !visited[nx * side + ny])
+                    directions[count++] = i;
+            }
+
+            if (count == 0)
+            {
+                length--;
+                continue;
+            }
+
+            int direction = directions[random.below(count)];
+            int next = (x + dx[direction]) * side + y + dy[direction];
+            visited[next] = 1;
+            path[length++] = next;
+            open_cell(x * 2 + dx[direction], y * 2 + dy[direction]);
+            open_cell(next / side * 2, next % side * 2);
+        }
+
+        delete[] visited;
+        delete[] path;
+
+        if (size % 2 == 0)
+        {
+            for (int i = 0; i < size; i++)
+            {
+                open_cell(size - 1, i);
+                open_cell(i, size - 1);
+            }
+        }
+    }
+
+    // Opens one more wall around every dead end, since the player cannot turn back without an undo
+    void braid_maze()
+    {
+        const int dx[4] = {-1, 1, 0, 0};
+        const int dy[4] = {0, 0, -1, 1};
+        for (int x = 0; x < size; x += 2)
+        {
+            for (int y = 0; y < size; y += 2)
+            {
+                int exits = 0;
+                int walls[4];
+                int count = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    int wx = x + dx[i], wy = y + dy[i];
+                    if (wx < 0 || wx >= size || wy < 0 || wy >= size)
+                        continue;
+                    if (!has_item(Pos(wx, wy), wall_flag))
+                        exits++;
+                    else if (wx + dx[i] >= 0 && wx + dx[i] < size && wy + dy[i] >= 0 && wy + dy[i] < size)
+                        walls[count++] = i; // Only walls with a room behind them lead anywhere
+                }
+
+                if (exits == 1 && count > 0)
+                {
+                    int direction = walls[random.below(count)];
+                    open_cell(x + dx[direction], y + dy[direction]);
+                }
+            }
+        }
+    }
+
+    // Marks or unmarks the cells of the way the level is won without bombs
+    void mark_route(bool marked)
+    {
+        // Both passes see the same solve, since no bomb is placed on the way
+        if (marked)
+            solve();
+
+        auto visit = [this, marked](int cell)
+        { set_item(Pos(cell / size, cell % size), route_flag, marked); };
+        if (size > LevelSolver::max_size)
+            finder.trace(visit);
+        else
+            solver.trace(visit);
+    }
+
+    // Builds the distance fields from the key and the door, treating bombs and walls as blocked
+    // Boards up to BitBoard::max_size wide are searched a ring at a time, the others a cell at a time
+    void build_distances()
+    {
+        if (size <= BitBoard::max_size)
+        {
+            BitBoard open(size);
+            for (int x = 0; x < size; x++)
+            {
+                uint64_t row = 0;
+                for (int y = 0; y < size; y++)
+                    row |= (uint64_t)((items[x * size + y] & (bomb_flag | wall_flag)) == 0) << y;
+                open.set_row(x, row);
+            }
+            key_field.build(size, key, open);
+            door_field.build(size, door, open);
+            return;
+        }
 
-        calculate_init_moves(level); // Calculates the initial moves given to player according to level
-        hide_cells(level); // Hides all cells except for those around the player
+        auto isBlocked = [this](int index)
+        { return (items[index] & (bomb_flag | wall_flag)) != 0; };
+        key_field.build(size, key, isBlocked, frontier);
+        door_field.build(size, door, isBlocked, frontier);
     }
 
-    // Sets the size of the grid
-    void set_size(int size)
+    // Returns the shortest path length from pos to the source of field, or the straight distance to target when the bombs cut it off
+    int path_distance(const DistanceField &field, Pos pos, Pos target)
     {
-        this->size = size;
-        grid.set_size(size);
+        if (field.reaches(pos))
+            return field.at(pos);
+        return abs(pos.x - target.x) + abs(pos.y - target.y);
     }
 
     // Initially gives moves to the player
     void calculate_init_moves(int level)
     {
         // Calculate distance to the key
-        int key_distance = 0;
-        int dx = abs(player.get_pos().x - key.x);
-        int dy = abs(player.get_pos().y - key.y);
-        key_distance = dx + dy;
+        int key_distance = path_distance(key_field, player.get_pos(), key);
 
         // Calculate distance to the door
-        int door_distance = 0;
-        dx = abs(key.x - door.x);
-        dy = abs(key.y - door.y);
-        door_distance = dx + dy;
+        int door_distance = path_distance(door_field, key, door);
 
-        // Calculate total distance
+        // Calculate total distance, the solver also counts the turns the player cannot make without an undo
         int total_distance = key_distance + door_distance;
+        if (solution.budget >= 0)
+            total_distance = solution.budget;
 
         // Calculate total moves
-        int extra_moves = level == 1 ? 6 : level == 2 ? 2
-                                                      : 0;
+        int extra_moves = level == 1 ? 6 : level == 2 || level == 4 ? 2
+                                                                    : 0;
         int total_moves = total_distance + extra_moves;
 
         player.set_moves(total_moves);
+
+        // Every move in the history has used one of the moves, so the history never outgrows the budget
+        player.reserve_moves(total_moves);
     }
 
     // Moves the player up
     bool move_up()
     {
 
-        if (player.get_pos().x - 1 >= 0)
+        if (player.get_pos().x - 1 >= 0 && !has_item(Pos(player.get_pos().x - 1, player.get_pos().y), wall_flag))
         {
             if (player.get_pos().x - 1 == player.get_last_move_pos().x && player.get_pos().y == player.get_last_move_pos().y)
                 return false;
@@ -1316,7 +3294,7 @@ public:
     bool move_down()
     {
 
-        if (player.get_pos().x + 1 < size)
+        if (player.get_pos().x + 1 < size && !has_item(Pos(player.get_pos().x + 1, player.get_pos().y), wall_flag))
         {
             if (player.get_pos().x + 1 == player.get_last_move_pos().x && player.get_pos().y == player.get_last_move_pos().y)
                 return false;
@@ -1339,7 +3317,7 @@ public:
     bool move_left()
     {
 
-        if (player.get_pos().y - 1 >= 0)
+        if (player.get_pos().y - 1 >= 0 && !has_item(Pos(player.get_pos().x, player.get_pos().y - 1), wall_flag))
         {
             if (player.get_pos().x == player.get_last_move_pos().x && player.get_pos().y - 1 == player.get_last_move_pos().y)
                 return false;
@@ -1362,7 +3340,7 @@ public:
     bool move_right()
     {
 
-        if (player.get_pos().y + 1 < size)
+        if (player.get_pos().y + 1 < size && !has_item(Pos(player.get_pos().x, player.get_pos().y + 1), wall_flag))
         {
             if (player.get_pos().x == player.get_last_move_pos().x && player.get_pos().y + 1 == player.get_last_move_pos().y)
                 return false;
@@ -1381,69 +3359,75 @@ public:
         return true;
     }
 
-    // Checks the collision of player with other things
-    void check_collision()
+    // Checks the collision of player with other things, returns the events it caused
+    unsigned check_collision()
+    {
+        unsigned events = 0;
+        if (collect_key())
+            events |= Event::key;
+        if (collect_coin())
+            events |= Event::coin;
+        if (hit_bomb())
+            events |= Event::bomb;
+        else if (check_moves())
+            events |= Event::no_moves;
+        return events;
+    }
+
+    // Returns the distance from the player to the key, or to the door once the player holds the key
+    int goal_distance()
     {
-        collect_key();
-        collect_coin();
-        hit_bomb();
-        check_moves();
+        return player.has_key() ? path_distance(door_field, player.get_pos(), door)
+                                : path_distance(key_field, player.get_pos(), key);
     }
 
     // Tells if the player is getting closer to goal or not
-    void getting_closer()
+    bool getting_closer()
     {
         int previous_distance = player.get_distance();
-
-        int x = 0, y = 0;
-
-        !(player.has_key()) ? (x = key.x, y = key.y) : (x = door.x, y = door.y);
-        int dx = abs(x - player.get_pos().x);
-        int dy = abs(y - player.get_pos().y);
-
-        int current_distance = dx + dy;
+        int current_distance = goal_distance();
         player.set_distance(current_distance);
 
-        printw("Hint: ");
-        if (current_distance < previous_distance)
-            printw("Getting Closer!\n");
-        else
-            printw("Further Away!\n");
+        return current_distance < previous_distance;
     }
 
-    // Checks if the player has reached the key
-    void collect_key()
+    // Checks if the player has reached the key, returns true when it is collected
+    bool collect_key()
     {
-        if (player.get_pos() == key)
+        if (player.get_pos() == key && !player.has_key())
         {
             player.key_status(true);
             grid.set_hide(player.get_pos(), false);
             grid.place_char(key, 'P');
+            return true;
         }
+        return false;
     }
 
-    // Checks if the player has collected a coin
-    void collect_coin()
+    // Checks if the player has collected a coin, returns true when one is collected
+    bool collect_coin()
     {
-        if (coins.contains(player.get_pos()))
+        if (has_item(player.get_pos(), coin_flag))
         {
             player.add_coin(player.get_pos());
             player.set_score(player.get_score() + 2); // Add 2 score for each coin
-            coins.remove(player.get_pos());
+            set_item(player.get_pos(), coin_flag, false);
             grid.place_char(player.get_pos(), 'P');
             player.set_undos(player.get_undos() + 1);
+            return true;
         }
+        return false;
     }
 
-    // Undo the last move
-    void undo_move(bool gameOver)
+    // Undo the last move, returns true when a move was taken back
+    bool undo_move(bool gameOver)
     {
         if (player.get_undos() > 0 || gameOver)
         {
             Pos previous = player.pop_last_move_pos();
 
             if (previous == Pos(-1, -1))
-                return;
+                return false;
 
             Pos current = player.get_pos();
             player.set_pos(previous);
@@ -1451,7 +3435,7 @@ public:
 
             if (player.find_in_coins(current)) // If there was a coin, place if back
             {
-                coins.add(current);
+                set_item(current, coin_flag, true);
                 grid.place_char(current, 'C');
             }
             else // Else place a space
@@ -1462,7 +3446,9 @@ public:
 
             player.set_moves(player.get_moves() + 1); // Return the last move used to the player
             grid.place_char(previous, 'P');
+            return true;
         }
+        return false;
     }
 
     // Checks if the player has the key and reached the door
@@ -1479,9 +3465,7 @@ public:
     // Reveal all cells
     void reveal_cells()
     {
-        for (int i = 0; i < size; i++)
-            for (int j = 0; j < size; j++)
-                grid.set_hide(Pos(i, j), false);
+        grid.set_hide_all(false);
     }
 
     // Revert the grid to original state after the game has ended
@@ -1496,74 +3480,413 @@ public:
         reveal_cells();
     }
 
-    // Game over function
-    void game_over(const char *message)
+    // Checks if the player has reached a bomb
+    bool hit_bomb()
     {
-        printw("\n");
-        clear();
-        printw("%s\n", message);
-        printw("Collected Coins:");
-        printw("\t\tRemaining Moves: %d\n", player.get_moves());
-        player.print_coins();
+        if (has_item(player.get_pos(), bomb_flag))
+        {
+            grid.place_char(player.get_pos(), 'B');
+            return true;
+        }
+        return false;
+    }
 
-        if (message == "Congratulations! You have reached the door!")
-            player.calculate_score();
-            
-        printw("Score: ");
-        printw("%d\n", player.get_score());
-        revert_grid();
-        printw("Original State of the game:\n");
-        display_grid();
-        printw("Press any key to exit...");
-        getch();
-        endwin();
-        exit(0);
+    // Checks if there are no moves left
+    bool check_moves()
+    {
+        // Reaching the door with the key on the last move still wins
+        return player.get_moves() == 0 && !(player.has_key() && player.get_pos() == door);
     }
 
-    // Checks if the player has reached a bomb
-    void hit_bomb()
+    // Plays one command and returns the events it caused
+    // Commands given after the game has ended are ignored
+    unsigned step(Command command)
     {
-        if (bombs.contains(player.get_pos()))
+        if (outcome != 0)
+            return 0;
+
+        Pos before = player.get_pos();
+        bool allowed = true;
+        unsigned events = 0;
+
+        switch (command)
         {
-            grid.place_char(player.get_pos(), 'B');
-            game_over("Hit Bomb!");
+        case Command::up:
+            allowed = move_up();
+            break;
+        case Command::down:
+            allowed = move_down();
+            break;
+        case Command::left:
+            allowed = move_left();
+            break;
+        case Command::right:
+            allowed = move_right();
+            break;
+        case Command::undo:
+            if (undo_move(false))
+                events |= Event::undone;
+            break;
+        case Command::none:
+            break;
         }
+
+        if (!allowed)
+            events |= Event::backtrack;
+        else if (command != Command::undo && player.get_pos() != before)
+            events |= Event::moved;
+
+        hide_cells(level);
+
+        events |= check_collision();
+        if (!(events & Event::over) && win_game())
+        {
+            player.calculate_score();
+            events |= Event::won;
+        }
+
+        closer = getting_closer();
+        if (closer)
+            events |= Event::closer;
+
+        outcome = events & Event::over;
+        return events;
     }
 
-    // Checks if there are no moves left
-    void check_moves()
+    // Returns if the game has ended
+    bool is_over()
+    {
+        return outcome != 0;
+    }
+
+    // Returns the event that ended the game, 0 while it is running
+    unsigned get_outcome()
+    {
+        return outcome;
+    }
+
+    // Returns if the last step brought the player closer to the goal
+    bool is_getting_closer()
+    {
+        return closer;
+    }
+
+    // Returns the difficulty level of the grid
+    int get_level()
+    {
+        return level;
+    }
+
+    // Returns the cells of the grid, for drawing
+    TwoDlist &get_board()
+    {
+        return grid;
+    }
+
+    // Returns how far the player can see, the custom level sees as far as medium
+    int visible_radius(int level)
     {
-        if (player.get_moves() == 0)
-            game_over("No More Moves!");
+        return level == 4 ? 2 : 4 - level;
     }
 
     // Hides all the cells except for around the player, visibility radius depends on the difficulty level
+    // Only the cells that enter or leave the visible square since the last call are updated
     void hide_cells(int level)
     {
-        int visibleRadius = 4 - level;
+        int visibleRadius = visible_radius(level);
+        Pos center = player.get_pos();
 
-        for (int i = 0; i < size; i++)
-            for (int j = 0; j < size; j++)
+        if (fog_radius < 0) // First call, start from a fully hidden grid
+        {
+            grid.set_hide_all(true);
+            update_fog(center, visibleRadius, false, center, -1);
+        }
+        else if (center != fog_center || visibleRadius != fog_radius)
+        {
+            update_fog(fog_center, fog_radius, true, center, visibleRadius);  // Hide the cells that left the square
+            update_fog(center, visibleRadius, false, fog_center, fog_radius); // Reveal the cells that entered the square
+        }
+
+        fog_center = center;
+        fog_radius = visibleRadius;
+    }
+
+    // Hides or reveals the cells in the square around center, skipping the cells inside the excluded square
+    // The key and the door are never revealed by the fog
+    void update_fog(Pos center, int radius, bool hide, Pos excluded, int excludedRadius)
+    {
+        int top = max(center.x - radius, 0);
+        int bottom = min(center.x + radius, size - 1);
+        int left = max(center.y - radius, 0);
+        int right = min(center.y + radius, size - 1);
+
+        bool keyHidden = grid.is_hidden(key);
+        bool doorHidden = grid.is_hidden(door);
+
+        for (int i = top; i <= bottom; i++)
+        {
+            if (i < excluded.x - excludedRadius || i > excluded.x + excludedRadius)
             {
-                if (i >= player.get_pos().x - visibleRadius && i <= player.get_pos().x + visibleRadius && j >= player.get_pos().y - visibleRadius && j <= player.get_pos().y + visibleRadius)
-                {
-                    if (Pos(i, j) != key && Pos(i, j) != door)
-                        grid.set_hide(Pos(i, j), false);
-                    continue;
-                }
-                grid.set_hide(Pos(i, j), true);
+                grid.set_hide_span(i, left, right, hide);
+                continue;
             }
+
+            // Only the parts of the row on either side of the excluded square are updated
+            grid.set_hide_span(i, left, min(right, excluded.y - excludedRadius - 1), hide);
+            grid.set_hide_span(i, max(left, excluded.y + excludedRadius + 1), right, hide);
+        }
+
+        if (!hide)
+        {
+            grid.set_hide(key, keyHidden);
+            grid.set_hide(door, doorHidden);
+        }
+    }
+};
+
+// Commands of one game and the level they were played on, enough to play the game again exactly
+//
+// Replay file layout, every number is little endian:
+//   "MZRP", uint8 version, uint8 level, uint16 board size, uint64 seed, uint64 stream, uint32 number of commands,
+//   then the commands two to a byte, the first in the low four bits
+class Replay
+{
+private:
+    static const unsigned char version = 1;
+    static const int count_offset = 24; // Where the command count lies in the file
+    static const int header_bytes = 28; // Where the commands start in the file
+
+    int level;
+    int size;
+    uint64_t seed;
+    uint64_t stream;
+    InlineList<unsigned char, 64> packed;
+    int count;
+    ofstream file; // Open while the replay is written out as it is played
+
+    // Writes a number in little endian order
+    static void write_number(ostream &out, uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+            out.put((char)(value >> (8 * i)));
+    }
+
+    // Writes the header, the level and the commands so far
+    void write_header()
+    {
+        file.seekp(0);
+        file.write("MZRP", 4);
+        write_number(file, version, 1);
+        write_number(file, level, 1);
+        write_number(file, size, 2);
+        write_number(file, seed, 8);
+        write_number(file, stream, 8);
+        write_number(file, count, 4);
+    }
+
+    // Reads a number in little endian order
+    static uint64_t read_number(istream &in, int bytes)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++)
+            value |= (uint64_t)(unsigned char)in.get() << (8 * i);
+        return value;
+    }
+
+public:
+    Replay()
+    {
+        level = 0;
+        size = 0;
+        seed = 0;
+        stream = 0;
+        count = 0;
+    }
+
+    Replay(const Replay &) = delete;
+    Replay &operator=(const Replay &) = delete;
+
+    // Starts writing the replay to a file, returns false when it cannot be opened
+    // The level and every command are written and flushed as soon as they are known, so a game that is cut short still leaves a replay of the moves played
+    bool record(const char *path)
+    {
+        file.open(path, ios::binary | ios::trunc);
+        return (bool)file;
+    }
+
+    // Returns false when writing the replay to its file has failed
+    bool is_written()
+    {
+        return !file.is_open() || (bool)file;
+    }
+
+    // Sets the level the commands are played on, the one built from random
+    void set_level(int level, int size, const Random &random)
+    {
+        this->level = level;
+        this->size = size;
+        seed = random.get_seed();
+        stream = random.get_stream();
+        if (file.is_open())
+        {
+            write_header();
+            file.flush();
+        }
+    }
+
+    // Appends a command
+    // When recording, the byte holding it is written before the count that takes it in, so the file is whole after every flush
+    void add(Command command)
+    {
+        if (count % 2 == 0)
+            packed.add((unsigned char)command);
+        else
+            packed.at(count / 2) |= (unsigned char)command << 4;
+        count++;
+
+        if (file.is_open())
+        {
+            file.seekp(header_bytes + (count - 1) / 2);
+            file.put((char)packed.at((count - 1) / 2));
+            file.seekp(count_offset);
+            write_number(file, count, 4);
+            file.flush();
+        }
+    }
+
+    // Returns the command at an index
+    Command at(int index)
+    {
+        if (index < 0 || index >= count)
+            throw std::out_of_range("Index out of range");
+
+        return (Command)((packed.at(index / 2) >> (index % 2 * 4)) & 15);
+    }
+
+    // Returns the number of commands
+    int get_count()
+    {
+        return count;
+    }
+
+    // Returns the difficulty level
+    int get_level()
+    {
+        return level;
+    }
+
+    // Returns the board size chosen for the custom level, 0 for the others
+    int get_size()
+    {
+        return size;
+    }
+
+    // Returns the generator the level is built with
+    Random get_random()
+    {
+        return Random(seed, stream);
+    }
+
+    // Reads a replay from a file, returns false when it cannot be read or is not a replay
+    bool load(const char *path)
+    {
+        ifstream file(path, ios::binary);
+        char magic[4] = {};
+        file.read(magic, 4);
+        if (!file || string(magic, 4) != "MZRP" || read_number(file, 1) != version)
+            return false;
+
+        level = (int)read_number(file, 1);
+        size = (int)read_number(file, 2);
+        seed = read_number(file, 8);
+        stream = read_number(file, 8);
+        int total = (int)read_number(file, 4);
+        if (!file || level < 1 || level > 4 || total < 0)
+            return false;
+
+        // Only the custom level has a size of its own, and it takes the same sizes the game offers
+        if (level == 4 ? size < 5 || size > 5000 : size != 0)
+            return false;
+
+        // The count comes from the file, so it is checked against the bytes the file holds before anything is reserved
+        int bytes = total / 2 + total % 2;
+        streamoff header = file.tellg();
+        file.seekg(0, ios::end);
+        streamoff left = file.tellg() - header;
+        file.seekg(header);
+        if (!file || left < bytes)
+            return false;
+
+        packed.clear();
+        count = 0;
+        packed.reserve(bytes);
+        for (int i = 0; i < total; i += 2)
+        {
+            int byte = file.get();
+            if (byte == EOF || (byte & 15) > (int)Command::none || (i + 1 < total && (byte >> 4) > (int)Command::none))
+                return false;
+            packed.add((unsigned char)byte);
+        }
+        count = total;
+        return true;
+    }
+};
+
+// Reads a whole decimal number given on the command line, returns false when text is not one
+inline bool read_number(const char *text, uint64_t &value)
+{
+    char *end = nullptr;
+    value = strtoull(text, &end, 10);
+    return end != text && *end == '\0';
+}
+
+#ifndef MAZE_HEADLESS
+// ncurses front end of the game, reads the keys, plays them on the grid and draws the result
+class Game
+{
+private:
+    Grid grid;
+    int level;
+    Replay *recording; // Commands are added here when set
+
+#ifdef MAZE_INSTRUMENT
+    static const int stats_lines = 2; // Frame and game counters printed below the grid
+#else
+    static const int stats_lines = 0;
+#endif
+
+    // Returns the command for a key, keys that mean nothing give none
+    static Command command_of(int key)
+    {
+        switch (key)
+        {
+        case 'w':
+            return Command::up;
+        case 's':
+            return Command::down;
+        case 'a':
+            return Command::left;
+        case 'd':
+            return Command::right;
+        case 'u':
+            return Command::undo;
+        }
+        return Command::none;
     }
 
     // Displays the player stats
-    void display_stats(int level)
+    void display_stats()
     {
+        Player &player = grid.get_player();
+
         if (level == 1)
             printw("Mode: Easy");
         else if (level == 2)
             printw("Mode: Medium");
         else if (level == 3)
             printw("Mode: Hard");
+        else if (level == 4)
+            printw("Mode: Custom (%dx%d)", grid.get_size(), grid.get_size());
 
         printw("\n");
         printw("Remaining Moves: ");
@@ -1580,90 +3903,125 @@ public:
         else
             printw("False");
         printw("\n");
-        getting_closer();
+
+        printw("Hint: ");
+        if (grid.is_getting_closer())
+            printw("Getting Closer!\n");
+        else
+            printw("Further Away!\n");
+    }
+
+    // Points the view of the grid at the player, sized to the space left on the terminal
+    void follow_player()
+    {
+        int rows = LINES - getcury(stdscr) - 2 - stats_lines; // Keep the lines for the messages below the grid
+        int cols = (COLS - 1) / 3; // Leave the last column free so a full row does not wrap
+        grid.get_board().set_view(grid.get_player().get_pos(), max(rows, 3), max(cols, 3));
     }
 
     // Displays the game grid
     void display_grid()
     {
-        grid.print_list();
+        follow_player();
+        grid.get_board().print_list();
     }
-};
-
-class Game
-{
-private:
-    Grid grid;
-    int level;
 
-public:
-    Game(int _level)
+    // Displays the game grid, redrawing only what changed since the last display
+    void display_changes()
     {
-        level = _level;
-        grid.initialize_grid(level);
-        grid.display_stats(level);
-        grid.display_grid();
+        follow_player();
+        grid.get_board().print_changes();
     }
 
-    // Moves the player based on the player input
-    bool move_player()
+    // Shows the end of the game and the grid as it was at the start
+    void game_over()
     {
-        int playerInput = getch();
-        bool moved = true;
-
-        switch (playerInput)
-        {
-        case 'w':
-            moved = grid.move_up();
-            break;
-
-        case 's':
-            moved = grid.move_down();
-            break;
-
-        case 'a':
-            moved = grid.move_left();
-            break;
+        Player &player = grid.get_player();
+        unsigned outcome = grid.get_outcome();
 
-        case 'd':
-            moved = grid.move_right();
-            break;
-        case 'u':
-            grid.undo_move(false);
-            break;
-        }
+        printw("\n");
+        clear();
+        if (outcome == Event::won)
+            printw("Congratulations! You have reached the door!\n");
+        else if (outcome == Event::bomb)
+            printw("Hit Bomb!\n");
+        else
+            printw("No More Moves!\n");
+        printw("Collected Coins:");
+        printw("\t\tRemaining Moves: %d\n", player.get_moves());
+        player.print_coins();
 
-        grid.hide_cells(level);
+        printw("Score: ");
+        printw("%d\n", player.get_score());
+        printw("Seed: %llu\n", (unsigned long long)grid.get_random().get_seed());
+#ifdef MAZE_INSTRUMENT
+        ContainerStats::current().print("Game");
+#endif
+        grid.revert_grid();
+        printw("Original State of the game:\n");
+        display_grid();
+        printw("Press any key to exit...");
+        refresh();
+    }
 
-        grid.check_collision();
-        if (grid.win_game())
-        {
-            grid.game_over("Congratulations! You have reached the door!");
-            return false;
-        }
+public:
+    Game(int _level, int _size = 0, const Random &random = Random(Random::fresh_seed()), Replay *_recording = nullptr)
+    {
+        level = _level;
+        recording = _recording;
+        grid.set_random(random);
+        grid.initialize_solvable_grid(level, _size);
+        if (recording != nullptr)
+            recording->set_level(level, _size, grid.get_random());
+        display_stats();
+        display_grid();
+    }
 
-        return moved;
+    // Moves the player based on the player input, returns the events of the move
+    unsigned move_player()
+    {
+        Command command = command_of(getch());
+        if (recording != nullptr)
+            recording->add(command);
+        return grid.step(command);
     }
 
-    // Runs the main game loop
+    // Runs the main game loop until the game ends
     void game_loop()
     {
         while (true)
         {
-            bool moved = move_player();
-            clear();
+#ifdef MAZE_INSTRUMENT
+            ContainerStats frameStart = ContainerStats::current();
+#endif
+            unsigned events = move_player();
+            if (grid.is_over())
+            {
+                game_over();
+                return;
+            }
 
-            grid.display_stats(level);
-            grid.display_grid();
+            move(0, 0); // Draw over the last frame instead of clearing the screen
+
+            display_stats();
+            display_changes();
 
             // If last move was not possible, display error message
-            if (!moved)
+            if (events & Event::backtrack)
             {
                 printw("Cannot move to the last position!\n");
                 printw("Use undo feature to move to the last position!\n");
             }
+#ifdef MAZE_INSTRUMENT
+            ContainerStats::current().since(frameStart).print("Frame");
+            ContainerStats::current().print("Game");
+#endif
+            clrtobot(); // Remove messages left from the last frame
+            refresh();
         }
     }
 };
 
+#endif
+
 #endif
\ No newline at end of file
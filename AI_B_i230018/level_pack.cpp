@@ -0,0 +1,210 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include <cstring>
+#define MAZE_HEADLESS // Levels are built without a terminal, so ncurses is left out
+#include "gameComponents.h"
+
+using namespace std;
+
+// Level pack layout, every number is little endian:
+//   header  "MAZEPACK", uint32 version, uint32 number of levels
+//   index   uint64 offset of every level from the start of the file
+//   levels  uint32 level, uint32 size, uint64 seed, uint64 stream,
+//           uint32 door, key and player cells, uint32 moves, uint32 undos,
+//           uint32 number of coins, uint32 number of bombs, uint32 cell of every coin, then of every bomb,
+//           one bit per cell row by row that is set for walls
+// Cells are stored as row * size + column
+const char pack_magic[8] = {'M', 'A', 'Z', 'E', 'P', 'A', 'C', 'K'};
+const uint32_t pack_version = 1;
+
+// A level is redrawn with another stream when it cannot be won, this many times at most
+const int max_attempts = 64;
+
+// Appends a number to the buffer in little endian order
+void put(vector<unsigned char> &buffer, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        buffer.push_back((unsigned char)(value >> (8 * i)));
+}
+
+// Returns the row major index of pos
+uint32_t cell_of(Pos pos, int size)
+{
+    return (uint32_t)(pos.x * size + pos.y);
+}
+
+// Builds level number index of the pack and encodes it into record
+// Returns the number of rejected attempts, or -1 when no attempt gave a level that can be won
+int build_level(int index, int count, int level, int size, uint64_t seed, vector<unsigned char> &record)
+{
+    for (int attempt = 0; attempt < max_attempts; attempt++)
+    {
+        // Every level and attempt has a stream of its own, so the pack does not depend on the number of threads
+        uint64_t stream = (uint64_t)attempt * count + index;
+
+        Grid grid;
+        grid.set_random(Random(seed, stream));
+        grid.initialize_grid(level, size);
+        if (!grid.is_solvable())
+            continue;
+
+        int gridSize = grid.get_size();
+        Player &player = grid.get_player();
+
+        // Collect the items from the item layer
+        vector<uint32_t> coins, bombs;
+        vector<unsigned char> walls((gridSize * gridSize + 7) / 8);
+        for (int x = 0; x < gridSize; x++)
+        {
+            for (int y = 0; y < gridSize; y++)
+            {
+                Pos pos(x, y);
+                uint32_t cell = cell_of(pos, gridSize);
+                if (grid.has_item(pos, Grid::coin_flag))
+                    coins.push_back(cell);
+                if (grid.has_item(pos, Grid::bomb_flag))
+                    bombs.push_back(cell);
+                if (grid.has_item(pos, Grid::wall_flag))
+                    walls[cell / 8] |= 1 << (cell % 8);
+            }
+        }
+
+        record.clear();
+        put(record, level, 4);
+        put(record, gridSize, 4);
+        put(record, seed, 8);
+        put(record, stream, 8);
+        put(record, cell_of(grid.get_door(), gridSize), 4);
+        put(record, cell_of(grid.get_key(), gridSize), 4);
+        put(record, cell_of(player.get_pos(), gridSize), 4);
+        put(record, player.get_moves(), 4);
+        put(record, player.get_undos(), 4);
+        put(record, coins.size(), 4);
+        put(record, bombs.size(), 4);
+        for (uint32_t cell : coins)
+            put(record, cell, 4);
+        for (uint32_t cell : bombs)
+            put(record, cell, 4);
+        record.insert(record.end(), walls.begin(), walls.end());
+        return attempt;
+    }
+
+    return -1;
+}
+
+// Builds the levels from first up to last, the work of one thread
+void build_levels(int first, int last, int count, int level, int size, uint64_t seed,
+                  vector<vector<unsigned char>> &records, atomic<long long> &rejected, atomic<bool> &failed)
+{
+    for (int i = first; i < last && !failed; i++)
+    {
+        int attempts = build_level(i, count, level, size, seed, records[i]);
+        if (attempts < 0)
+            failed = true;
+        else
+            rejected += attempts;
+    }
+}
+
+// Prints how to run the tool
+void print_usage(const char *name)
+{
+    cerr << "Usage: " << name << " <output file> <number of levels> [--level 1-4] [--size 5-5000] [--seed number] [--threads number]" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char *output = argv[1];
+    uint64_t count = 0;
+    uint64_t level = 2;
+    uint64_t size = 0;
+    uint64_t seed = Random::fresh_seed();
+    uint64_t threads = max(1u, thread::hardware_concurrency());
+    bool valid = read_number(argv[2], count) && count > 0 && count < (1u << 31);
+
+    for (int i = 3; i < argc && valid; i++)
+    {
+        if (i + 1 >= argc)
+            valid = false;
+        else if (strcmp(argv[i], "--level") == 0)
+            valid = read_number(argv[++i], level) && level >= 1 && level <= 4;
+        else if (strcmp(argv[i], "--size") == 0)
+            valid = read_number(argv[++i], size) && size >= 5 && size <= 5000;
+        else if (strcmp(argv[i], "--seed") == 0)
+            valid = read_number(argv[++i], seed);
+        else if (strcmp(argv[i], "--threads") == 0)
+            valid = read_number(argv[++i], threads) && threads >= 1 && threads <= 1024;
+        else
+            valid = false;
+    }
+
+    // The custom level needs a size and the others have their own
+    if (!valid || (level == 4) != (size != 0))
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    vector<vector<unsigned char>> records(count);
+    atomic<long long> rejected(0);
+    atomic<bool> failed(false);
+
+    // Every thread builds a contiguous share of the levels into its own records, so the threads never wait on each other
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (uint64_t t = 0; t < threads; t++)
+    {
+        int first = (int)(count * t / threads);
+        int last = (int)(count * (t + 1) / threads);
+        workers.emplace_back(build_levels, first, last, (int)count, (int)level, (int)size, seed,
+                             ref(records), ref(rejected), ref(failed));
+    }
+    for (thread &worker : workers)
+        worker.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (failed)
+    {
+        cerr << "Could not build a level that can be won in " << max_attempts << " attempts" << endl;
+        return 1;
+    }
+
+    // Write the header, then the index, then the levels in order
+    vector<unsigned char> header(pack_magic, pack_magic + 8);
+    put(header, pack_version, 4);
+    put(header, count, 4);
+    uint64_t offset = header.size() + 8 * count;
+    for (const vector<unsigned char> &record : records)
+    {
+        put(header, offset, 8);
+        offset += record.size();
+    }
+
+    ofstream file(output, ios::binary);
+    file.write((const char *)header.data(), header.size());
+    for (const vector<unsigned char> &record : records)
+        file.write((const char *)record.data(), record.size());
+    if (!file)
+    {
+        cerr << "Could not write " << output << endl;
+        return 1;
+    }
+
+    cout << "Wrote " << count << " levels to " << output << " (" << offset << " bytes)" << endl;
+    cout << "Seed: " << seed << ", threads: " << threads << ", rejected levels: " << rejected << endl;
+    cout << "Time: " << seconds << " s, " << count / seconds << " levels per second" << endl;
+
+    return 0;
+}